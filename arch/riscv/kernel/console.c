@@ -0,0 +1,174 @@
+#include "console.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "stdio.h"
+#include "wait.h"
+
+#define ISR_NO_INT 0x01      // ISR（IIR）最低位为 1 表示没有挂起的中断
+#define UART_TX_FIFO_SIZE 16
+
+#define CONS_NOTIFY_RX 0x1
+#define CONS_NOTIFY_TX 0x2
+
+static struct {
+  bool ready;                   // console_init 之前直接轮询 UART 输出
+
+  struct spinlock lock;         // 读者之间互斥，保护 rx_r
+  struct wait_queue_head wait;  // 等待输入的进程
+  char rx_buf[CONSOLE_RX_BUF_SIZE];
+  uint64_t rx_r;                // 读者推进
+  uint64_t rx_w;                // M 模式推进
+
+  struct spinlock tx_lock;      // 写者之间互斥，保护 tx_w 和 IER
+  struct wait_queue_head tx_wait; // 等待输出环腾出空间的进程
+  char tx_buf[CONSOLE_TX_BUF_SIZE];
+  uint64_t tx_r;                // M 模式推进
+  uint64_t tx_w;                // 写者推进
+
+  uint64_t notify;              // M 模式处理过的方向，还没有唤醒等待者
+} cons;
+
+void console_init(void) {
+  spin_lock_init(&cons.lock);
+  init_waitqueue_head(&cons.wait);
+  spin_lock_init(&cons.tx_lock);
+  init_waitqueue_head(&cons.tx_wait);
+  WriteReg(FCR, FCR_FIFO_ENABLE | FCR_FIFO_CLEAR);
+  WriteReg(IER, IER_RX_ENABLE);
+  cons.ready = 1;
+}
+
+// 以下两个函数在 M 模式下运行，只通过 PC 相对寻址访问 cons，不能加锁，也不能使用 tp
+
+static uint64_t console_rx(void) {
+  uint64_t w = cons.rx_w, start = w;
+  while (ReadReg(LSR) & LSR_RX_READY) {
+    char c = ReadReg(RHR);
+    // 环满时丢弃新到的字节
+    if (w - __atomic_load_n(&cons.rx_r, __ATOMIC_ACQUIRE) < CONSOLE_RX_BUF_SIZE) {
+      cons.rx_buf[w % CONSOLE_RX_BUF_SIZE] = c;
+      w++;
+    }
+  }
+  __atomic_store_n(&cons.rx_w, w, __ATOMIC_RELEASE);
+  return w - start;
+}
+
+// 发送 FIFO 为空时一次填满它
+static uint64_t console_tx(void) {
+  if (!(ReadReg(LSR) & LSR_TX_IDLE)) {
+    return 0;
+  }
+  uint64_t r = cons.tx_r, start = r;
+  uint64_t w = __atomic_load_n(&cons.tx_w, __ATOMIC_ACQUIRE);
+  while (r != w && r - start < UART_TX_FIFO_SIZE) {
+    WriteReg(THR, cons.tx_buf[r % CONSOLE_TX_BUF_SIZE]);
+    r++;
+  }
+  __atomic_store_n(&cons.tx_r, r, __ATOMIC_RELEASE);
+  return r - start;
+}
+
+void console_intr(void) {
+  uint64_t notify = 0;
+  // 读 ISR 会清除 THRE 中断，输出环为空时就靠它让 UART 撤销中断
+  while (!(ReadReg(ISR) & ISR_NO_INT)) {
+    if (console_rx()) {
+      notify |= CONS_NOTIFY_RX;
+    }
+    if (console_tx()) {
+      notify |= CONS_NOTIFY_TX;
+    }
+  }
+  __atomic_fetch_or(&cons.notify, notify, __ATOMIC_RELEASE);
+}
+
+void console_wakeup(void) {
+  if (!__atomic_load_n(&cons.notify, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  uint64_t notify = __atomic_exchange_n(&cons.notify, 0, __ATOMIC_ACQ_REL);
+  // 等待者在锁内检查环、挂到等待队列上，
+  // 先与它同步一次，保证它要么看到了环的变化，要么已经在队列上
+  if (notify & CONS_NOTIFY_RX) {
+    spin_lock(&cons.lock);
+    spin_unlock(&cons.lock);
+    wake_up(&cons.wait);
+  }
+  if (notify & CONS_NOTIFY_TX) {
+    spin_lock(&cons.tx_lock);
+    spin_unlock(&cons.tx_lock);
+    wake_up(&cons.tx_wait);
+  }
+}
+
+long console_read(char *buf, uint64_t count) {
+  uint64_t n = 0;
+  if (count == 0) {
+    return 0;
+  }
+
+  spin_lock(&cons.lock);
+  while (cons.rx_r == __atomic_load_n(&cons.rx_w, __ATOMIC_ACQUIRE)) {
+    sleep_on_locked(&cons.wait, &cons.lock);
+  }
+  // 一次把已到达的输入尽量读完
+  uint64_t r = cons.rx_r, w = __atomic_load_n(&cons.rx_w, __ATOMIC_ACQUIRE);
+  while (n < count && r != w) {
+    buf[n++] = cons.rx_buf[r % CONSOLE_RX_BUF_SIZE];
+    r++;
+  }
+  __atomic_store_n(&cons.rx_r, r, __ATOMIC_RELEASE);
+  spin_unlock(&cons.lock);
+  return n;
+}
+
+// 重新打开 THRE 中断：发送 FIFO 为空时 UART 立即产生一次中断，
+// 否则在当前的数据发送完后产生，之后由 console_intr 持续填充
+static void console_kick(void) {
+  WriteReg(IER, IER_RX_ENABLE);
+  WriteReg(IER, IER_RX_ENABLE | IER_TX_ENABLE);
+}
+
+// 调用者持有 tx_lock。can_sleep 为 0 时在环满时忙等，供内核 printf 使用
+static void __console_write(const char *buf, uint64_t count, bool can_sleep) {
+  while (count) {
+    uint64_t w = cons.tx_w;
+    uint64_t space = CONSOLE_TX_BUF_SIZE - (w - __atomic_load_n(&cons.tx_r, __ATOMIC_ACQUIRE));
+    if (space == 0) {
+      if (can_sleep) {
+        sleep_on_locked(&cons.tx_wait, &cons.tx_lock);
+      } else {
+        ipi_poll();
+      }
+      continue;
+    }
+    uint64_t n = count < space ? count : space;
+    for (uint64_t i = 0; i < n; i++) {
+      cons.tx_buf[(w + i) % CONSOLE_TX_BUF_SIZE] = buf[i];
+    }
+    __atomic_store_n(&cons.tx_w, w + n, __ATOMIC_RELEASE);
+    console_kick();
+    buf += n;
+    count -= n;
+  }
+}
+
+long console_write(const char *buf, uint64_t count) {
+  spin_lock(&cons.tx_lock);
+  __console_write(buf, count, 1);
+  spin_unlock(&cons.tx_lock);
+  return count;
+}
+
+void console_write_atomic(const char *buf, uint64_t count) {
+  if (!cons.ready) {
+    for (uint64_t i = 0; i < count; i++) {
+      putchar(buf[i]);
+    }
+    return;
+  }
+  spin_lock(&cons.tx_lock);
+  __console_write(buf, count, 0);
+  spin_unlock(&cons.tx_lock);
+}
@@ -0,0 +1,244 @@
+#include "exec.h"
+#include "elf.h"
+#include "filemap.h"
+#include "fs.h"
+#include "mm.h"
+#include "slub.h"
+#include "stdio.h"
+#include "task_manager.h"
+#include "vdso.h"
+#include "vm.h"
+
+// 用户栈固定在这一页，段不能覆盖它
+#define USER_STACK_ADDR 0x1002000
+
+// exec 过程中用到的临时数据，放在栈上太大
+struct exec_image {
+  Elf64_Ehdr ehdr;
+  Elf64_Phdr phdrs[EXEC_MAX_PHDRS];
+  struct vm_area_struct *vmas[2 * EXEC_MAX_PHDRS];
+  uint64_t zero[2 * EXEC_MAX_PHDRS]; // vmas[i] 中从这个地址到页尾要清零，0 表示不需要
+  int nr_vmas;
+};
+
+int copy_exec_path(char *dst, const char *src) {
+  int n = 0;
+  for (int i = 0; n < EXEC_PATH_MAX - 1; i++) {
+    uint64_t va = (uint64_t)(src + i);
+    if ((i == 0 || va % PAGE_SIZE == 0) && fault_in_user(va, 1, 0)) {
+      return -1;
+    }
+    if (i == 0 && src[0] != '/') {
+      dst[n++] = '/';
+    }
+    dst[n++] = src[i];
+    if (src[i] == '\0') {
+      return i ? 0 : -1;
+    }
+  }
+  return -1;
+}
+
+static bool overlaps(uint64_t s1, uint64_t e1, uint64_t s2, uint64_t e2) {
+  return s1 < e2 && s2 < e1;
+}
+
+// 读出并检查文件头和程序头，调用者持有 fs_lock。
+// 程序头必须都在文件的第一块中，ld 总是把它们放在文件开头
+static int read_headers(const char *path, struct exec_image *img,
+                        uint32_t *ino, uint32_t *size) {
+  Elf64_Ehdr *ehdr = &img->ehdr;
+  *ino = sfs_lookup(path, size);
+  if (*ino == 0 || *size < sizeof(Elf64_Ehdr)) {
+    return -1;
+  }
+  Mblock mem = sfs_get_data_block(*ino, 0);
+  if (mem == NULL) {
+    return -1;
+  }
+  memcpy(ehdr, mem->block.block, sizeof(Elf64_Ehdr));
+
+  uint64_t limit = *size < PAGE_SIZE ? *size : PAGE_SIZE;
+  if (ehdr->e_ident[0] != ELFMAG0 || ehdr->e_ident[1] != ELFMAG1 ||
+      ehdr->e_ident[2] != ELFMAG2 || ehdr->e_ident[3] != ELFMAG3 ||
+      ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+      ehdr->e_ident[EI_DATA] != ELFDATA2LSB || ehdr->e_type != ET_EXEC ||
+      ehdr->e_machine != EM_RISCV ||
+      ehdr->e_phentsize != sizeof(Elf64_Phdr) ||
+      ehdr->e_phnum > EXEC_MAX_PHDRS || ehdr->e_phoff > limit ||
+      ehdr->e_phoff + ehdr->e_phnum * sizeof(Elf64_Phdr) > limit) {
+    return -1;
+  }
+  memcpy(img->phdrs, mem->block.block + ehdr->e_phoff,
+         ehdr->e_phnum * sizeof(Elf64_Phdr));
+  return 0;
+}
+
+// 段的范围（按页取整）不能超出用户程序区，也不能与其他段重叠
+static int check_segments(struct exec_image *img, uint32_t size) {
+  bool entry_ok = 0;
+  for (int i = 0; i < img->ehdr.e_phnum; i++) {
+    Elf64_Phdr *ph = &img->phdrs[i];
+    if (ph->p_type != PT_LOAD || ph->p_memsz == 0) {
+      continue;
+    }
+    uint64_t start = ROUNDDOWN(ph->p_vaddr, PAGE_SIZE);
+    uint64_t end = ph->p_vaddr + ph->p_memsz;
+    if (ph->p_filesz > ph->p_memsz || end < ph->p_vaddr ||
+        ph->p_offset + ph->p_filesz < ph->p_offset ||
+        ph->p_offset + ph->p_filesz > size ||
+        ph->p_vaddr % PAGE_SIZE != ph->p_offset % PAGE_SIZE) {
+      return -1;
+    }
+    end = ROUNDUP(end, PAGE_SIZE);
+    if (start < PAGE_SIZE || end > USER_HEAP_START ||
+        overlaps(start, end, USER_STACK_ADDR, USER_STACK_ADDR + PAGE_SIZE) ||
+        overlaps(start, end, VVAR_ADDR, VVAR_ADDR + PAGE_SIZE)) {
+      return -1;
+    }
+    for (int j = 0; j < i; j++) {
+      Elf64_Phdr *other = &img->phdrs[j];
+      if (other->p_type == PT_LOAD && other->p_memsz &&
+          overlaps(start, end, ROUNDDOWN(other->p_vaddr, PAGE_SIZE),
+                   ROUNDUP(other->p_vaddr + other->p_memsz, PAGE_SIZE))) {
+        return -1;
+      }
+    }
+    if ((ph->p_flags & PF_X) && img->ehdr.e_entry >= ph->p_vaddr &&
+        img->ehdr.e_entry < ph->p_vaddr + ph->p_memsz) {
+      entry_ok = 1;
+    }
+  }
+  return entry_ok ? 0 : -1;
+}
+
+static struct vm_area_struct *new_vma(struct exec_image *img, uint64_t start,
+                                      uint64_t end, uint64_t prot,
+                                      unsigned long flags) {
+  struct vm_area_struct *vma = kmalloc(sizeof(struct vm_area_struct));
+  if (vma == NULL) {
+    return NULL;
+  }
+  memset(vma, 0, sizeof(struct vm_area_struct));
+  vma->vm_start = start;
+  vma->vm_end = end;
+  vma->vm_flags = prot;
+  vma->vm_mmap_flags = flags;
+  img->zero[img->nr_vmas] = 0;
+  img->vmas[img->nr_vmas++] = vma;
+  return vma;
+}
+
+static void free_vmas(struct exec_image *img) {
+  for (int i = 0; i < img->nr_vmas; i++) {
+    if (img->vmas[i]->vm_pages) {
+      kfree(img->vmas[i]->vm_pages);
+    }
+    kfree(img->vmas[i]);
+  }
+}
+
+// 为每个段准备好 VMA，这之后唯一可能失败的只有 bss 清零时的缺页
+static int setup_vmas(struct exec_image *img, uint32_t ino) {
+  for (int i = 0; i < img->ehdr.e_phnum; i++) {
+    Elf64_Phdr *ph = &img->phdrs[i];
+    if (ph->p_type != PT_LOAD || ph->p_memsz == 0) {
+      continue;
+    }
+    // RISC-V 的页表项不允许可写不可读
+    uint64_t prot = PTE_V | PTE_U |
+                    ((ph->p_flags & (PF_R | PF_W)) ? PTE_R : 0) |
+                    ((ph->p_flags & PF_W) ? PTE_W : 0) |
+                    ((ph->p_flags & PF_X) ? PTE_X : 0);
+    uint64_t start = ROUNDDOWN(ph->p_vaddr, PAGE_SIZE);
+    uint64_t file_end = ROUNDUP(ph->p_vaddr + ph->p_filesz, PAGE_SIZE);
+    uint64_t end = ROUNDUP(ph->p_vaddr + ph->p_memsz, PAGE_SIZE);
+
+    if (ph->p_filesz) {
+      struct vm_area_struct *vma = new_vma(img, start, file_end, prot, MAP_PRIVATE);
+      if (vma == NULL) {
+        return -1;
+      }
+      vma->vm_ino = ino;
+      vma->vm_pgoff = ph->p_offset / PAGE_SIZE;
+      vma->vm_pages = kmalloc(vma_pages(vma) * sizeof(Mblock));
+      if (vma->vm_pages == NULL) {
+        return -1;
+      }
+      memset(vma->vm_pages, 0, vma_pages(vma) * sizeof(Mblock));
+      // 最后一页中文件数据之后的内容属于 bss（或者是文件里的其他东西）
+      uint64_t data_end = ph->p_vaddr + ph->p_filesz;
+      if (ph->p_memsz > ph->p_filesz && data_end % PAGE_SIZE) {
+        img->zero[img->nr_vmas - 1] = data_end;
+      }
+    } else {
+      file_end = start;
+    }
+
+    if (end > file_end &&
+        new_vma(img, file_end, end, prot, MAP_PRIVATE | MAP_ANONYMOUS | VM_PAGED) == NULL) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int do_execve(const char *path, uint64_t *entry) {
+  struct mm_struct *mm = current->mm;
+  uint64_t *pgtbl = current_pgtbl();
+  struct exec_image *img = kmalloc(sizeof(struct exec_image));
+  uint32_t ino, size;
+  if (img == NULL) {
+    return -1;
+  }
+  img->nr_vmas = 0;
+
+  spin_lock(&fs_lock);
+  int ret = read_headers(path, img, &ino, &size);
+  spin_unlock(&fs_lock);
+  if (ret || check_segments(img, size) || setup_vmas(img, ino)) {
+    free_vmas(img);
+    kfree(img);
+    return -1;
+  }
+
+  // 从这里开始不能再回到原来的程序
+  spin_lock(&mm->lock);
+  struct vm_area_struct *vma, *tmp;
+  list_for_each_entry_safe(vma, tmp, &mm->vm->vm_list, vm_list) {
+    destroy_vma(mm, pgtbl, vma);
+  }
+  mm->start_brk = mm->brk = USER_HEAP_START;
+
+  for (int i = 0; i < img->nr_vmas; i++) {
+    insert_vma(mm, img->vmas[i]);
+  }
+  // 只有与文件数据同页的 bss 需要现在处理：写缺页得到私有副本，再把尾部清零
+  for (int i = 0; i < img->nr_vmas; i++) {
+    uint64_t addr = img->zero[i];
+    if (addr == 0) {
+      continue;
+    }
+    if (handle_vma_fault(mm, pgtbl, img->vmas[i], addr, 1)) {
+      spin_unlock(&mm->lock);
+      kfree(img);
+      return -2;
+    }
+    uint64_t pa = (get_pte(pgtbl, addr) >> 10) << 12;
+    memset((void *)(pa + addr % PAGE_SIZE), 0, PAGE_SIZE - addr % PAGE_SIZE);
+  }
+  spin_unlock(&mm->lock);
+
+  *entry = img->ehdr.e_entry;
+  kfree(img);
+  return 0;
+}
+
+uint64_t exec_init(void) {
+  uint64_t entry;
+  if (do_execve(INIT_PATH, &entry)) {
+    printf("Cannot exec %s\n", INIT_PATH);
+    while (1);
+  }
+  return entry;
+}
@@ -0,0 +1,146 @@
+#include "filemap.h"
+#include "fs.h"
+#include "mm.h"
+#include "slub.h"
+#include "tlb.h"
+#include "vm.h"
+
+#define PTE_PERM_MASK (PTE_V | PTE_R | PTE_W | PTE_X | PTE_U)
+
+// 会访问 SFS 缓存块，调用者持有 fs_lock
+static int __filemap_fault(struct mm_struct *mm, uint64_t *pgtbl,
+                           struct vm_area_struct *vma, uint64_t addr,
+                           bool write) {
+  uint64_t va = ROUNDDOWN(addr, PAGE_SIZE);
+  uint64_t idx = (va - vma->vm_start) / PAGE_SIZE;
+  uint64_t pte = get_pte(pgtbl, va);
+
+  if (pte & PTE_V) {
+    // 页已映射为只读，只有写访问会走到这里
+    Mblock mem = vma->vm_pages[idx];
+    if (!write || mem == NULL) {
+      return 0;
+    }
+    if (vma->vm_mmap_flags & MAP_SHARED) {
+      mem->dirty = 1;
+      create_mapping(pgtbl, va, (pte >> 10) << 12, PAGE_SIZE, vma->vm_flags);
+    } else {
+      // 写时复制：从缓存块拷贝出私有页
+      uint64_t pa = alloc_page();
+      if (pa == 0) {
+        return -1;
+      }
+      memcpy((void *)pa, (void *)((pte >> 10) << 12), PAGE_SIZE);
+      create_mapping(pgtbl, va, pa, PAGE_SIZE, vma->vm_flags);
+      vma->vm_pages[idx] = NULL;
+      sfs_unmap_block(mem);
+    }
+    flush_tlb_page(mm, va);
+    return 0;
+  }
+
+  Mblock mem = sfs_get_data_block(vma->vm_ino, vma->vm_pgoff + idx);
+  if (mem == NULL) {
+    return -1;
+  }
+  mem->map_count++;
+  vma->vm_pages[idx] = mem;
+  vma->mapped = 1;
+
+  // 先只读映射，写访问再走一次上面的分支
+  create_mapping(pgtbl, va, PHYSICAL_ADDR(mem->block.block), PAGE_SIZE,
+                 vma->vm_flags & ~PTE_W);
+  if (write) {
+    return __filemap_fault(mm, pgtbl, vma, addr, write);
+  }
+  return 0;
+}
+
+int filemap_fault(struct mm_struct *mm, uint64_t *pgtbl,
+                  struct vm_area_struct *vma, uint64_t addr, bool write) {
+  spin_lock(&fs_lock);
+  int ret = __filemap_fault(mm, pgtbl, vma, addr, write);
+  spin_unlock(&fs_lock);
+  return ret;
+}
+
+int filemap_populate(struct mm_struct *mm, uint64_t *pgtbl,
+                     struct vm_area_struct *vma) {
+  spin_lock(&fs_lock);
+  for (uint64_t i = 0; i < vma_pages(vma); i++) {
+    uint64_t va = vma->vm_start + i * PAGE_SIZE;
+    if (get_pte(pgtbl, va) & PTE_V) {
+      continue;
+    }
+    // 超出文件末尾的部分保持未映射
+    if (__filemap_fault(mm, pgtbl, vma, va, 0)) {
+      break;
+    }
+  }
+  spin_unlock(&fs_lock);
+  return 0;
+}
+
+void filemap_zap(struct mm_struct *mm, uint64_t *pgtbl,
+                 struct vm_area_struct *vma) {
+  spin_lock(&fs_lock);
+  for (uint64_t i = 0; i < vma_pages(vma); i++) {
+    uint64_t va = vma->vm_start + i * PAGE_SIZE;
+    uint64_t pte = get_pte(pgtbl, va);
+    if (!(pte & PTE_V)) {
+      continue;
+    }
+    Mblock mem = vma->vm_pages[i];
+    if (mem) {
+      // 上次写回之后可能还有写入
+      if ((pte & PTE_W) && (vma->vm_mmap_flags & MAP_SHARED)) {
+        mem->dirty = 1;
+      }
+      vma->vm_pages[i] = NULL;
+      sfs_unmap_block(mem);
+    } else {
+      free_pages((pte >> 10) << 12);
+    }
+    create_mapping(pgtbl, va, 0, PAGE_SIZE, 0);
+  }
+  spin_unlock(&fs_lock);
+  flush_tlb_range(mm, vma->vm_start, vma->vm_end);
+  vma->mapped = 0;
+}
+
+int filemap_copy(uint64_t *dst_pgtbl, uint64_t *src_pgtbl,
+                 struct vm_area_struct *dst, struct vm_area_struct *src) {
+  dst->vm_pages = kmalloc(vma_pages(src) * sizeof(Mblock));
+  if (dst->vm_pages == NULL) {
+    // 没有 vm_pages 的 dst 会按匿名 VMA 释放，不能让它以为自己已有映射
+    dst->mapped = 0;
+    return -1;
+  }
+  memset(dst->vm_pages, 0, vma_pages(src) * sizeof(Mblock));
+
+  spin_lock(&fs_lock);
+  for (uint64_t i = 0; i < vma_pages(src); i++) {
+    uint64_t va = src->vm_start + i * PAGE_SIZE;
+    uint64_t pte = get_pte(src_pgtbl, va);
+    if (!(pte & PTE_V)) {
+      continue;
+    }
+    Mblock mem = src->vm_pages[i];
+    if (mem) {
+      mem->map_count++;
+      dst->vm_pages[i] = mem;
+      create_mapping(dst_pgtbl, va, (pte >> 10) << 12, PAGE_SIZE,
+                     pte & PTE_PERM_MASK);
+    } else {
+      uint64_t pa = alloc_page();
+      if (pa == 0) {
+        spin_unlock(&fs_lock);
+        return -1;
+      }
+      memcpy((void *)pa, (void *)((pte >> 10) << 12), PAGE_SIZE);
+      create_mapping(dst_pgtbl, va, pa, PAGE_SIZE, src->vm_flags);
+    }
+  }
+  spin_unlock(&fs_lock);
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include "fpu.h"
+#include "mm.h"
+#include "riscv.h"
+#include "smp.h"
+#include "task_manager.h"
+
+static inline uint64_t fp_status(void) {
+  return read_csr(sstatus) & SSTATUS_FS;
+}
+
+static inline void fp_set_status(uint64_t fs) {
+  clear_csr(sstatus, SSTATUS_FS);
+  set_csr(sstatus, fs);
+}
+
+void fp_switch_out(struct task_struct *prev) {
+  uint64_t fs = fp_status();
+  if (fs == SSTATUS_FS_OFF) {
+    return;
+  }
+  // 只有 current 能打开浮点单元，所以寄存器里就是 prev 的状态
+  if (fs == SSTATUS_FS_DIRTY) {
+    __fp_save(&prev->fp);
+  }
+  fp_set_status(SSTATUS_FS_OFF);
+}
+
+bool fp_trap(void) {
+  struct cpu *c = this_cpu();
+  struct task_struct *p = c->curr;
+
+  // 浮点单元已经打开，说明确实是非法指令
+  if (fp_status() != SSTATUS_FS_OFF) {
+    return 0;
+  }
+  // p 上次恢复之后，它的状态可能在其他 hart 上被修改过，或者寄存器被别的进程用过
+  if (c->fp_owner != p || p->fp_cpu != c->id) {
+    fp_set_status(SSTATUS_FS_INITIAL);
+    __fp_restore(&p->fp);
+    c->fp_owner = p;
+    p->fp_cpu = c->id;
+  }
+  fp_set_status(SSTATUS_FS_CLEAN);
+  return 1;
+}
+
+void fp_flush(void) {
+  if (fp_status() == SSTATUS_FS_DIRTY) {
+    __fp_save(&current->fp);
+    fp_set_status(SSTATUS_FS_CLEAN);
+  }
+}
+
+void fp_reset(void) {
+  memset(&current->fp, 0, sizeof(struct fp_state));
+  current->fp_cpu = -1;
+  fp_set_status(SSTATUS_FS_OFF);
+}
@@ -6,6 +6,7 @@
 #include "virtio.h"
 #include "vm.h"
 #include "mm.h"
+#include "pipe.h"
 
 // --------------------------------------------------
 // ----------- read and write interface -------------
@@ -41,6 +42,8 @@ int strsize(char* a){
 
 struct sfs_fs* fs = NULL;
 
+struct spinlock fs_lock = SPINLOCK_INIT;
+
 Mblock inode_to_mem(INODE din, int no){
     Mblock mem = (Mblock)kmalloc(sizeof(struct sfs_memory_block));
 //    Mem_used += sizeof(sfs_memory_block);
@@ -66,17 +69,26 @@ Mblock entry_to_mem(ENTRY den, int no){
 Mblock data_to_mem(char* data, int no){
     Mblock mem = (Mblock)kmalloc(sizeof(struct sfs_memory_block));
 //    Mem_used += sizeof(sfs_memory_block);
-    mem->block.block = (char*)kmalloc(4097);
-//    Mem_used += 4097;
-    memcpy(mem->block.block, data, strsize(data));
+    // 直接接管 data（整页对齐的 4097 字节缓冲区），整块保留，二进制数据中的 '\0' 不会截断
+    mem->block.block = data;
     mem->kind = BLOCK;
     mem->blockno = no;
     mem->dirty = 0;
     mem->reclaim_count = 1;
+    mem->map_count = 0;
+    mem->next = NULL;
     return mem;
 }
 
 int write_back(Mblock mem){
+    // 仍被用户态映射的块只写回磁盘，不释放缓冲区
+    if(mem->map_count){
+        if(mem->dirty){
+            disk_write(mem->blockno, mem->block.block);
+            mem->dirty = 0;
+        }
+        return 1;
+    }
     if(!(mem->dirty)){
         if((!fs->hash[mem->blockno%256])&&(fs->hash[mem->blockno%256]==mem->blockno)) {
             kfree(fs->hash[mem->blockno % 256]);
@@ -115,11 +127,32 @@ void add_cache(Mblock mem){
         fs->hash[no%256] = mem;
     }
     else if(fs->hash[no%256]->blockno != no){
-        write_back(fs->hash[no%256]);
+        Mblock old = fs->hash[no%256];
+        write_back(old);
+        if(old->map_count){
+            old->next = fs->detached;
+            fs->detached = old;
+        }
         fs->hash[no%256] = mem;
     }
 }
 
+// 在被挤出 hash 的映射块中查找 num，找到则摘下重新放回 hash
+static Mblock find_detached(uint32_t num){
+    Mblock* link = &fs->detached;
+    while(*link){
+        Mblock mem = *link;
+        if(mem->blockno == num){
+            *link = mem->next;
+            mem->next = NULL;
+            add_cache(mem);
+            return mem;
+        }
+        link = &mem->next;
+    }
+    return NULL;
+}
+
 uint32_t find_freeblock(){
     uint8_t And = 0b11111111, one = 0b00000001;
     uint32_t i;
@@ -156,6 +189,7 @@ Mblock find_block(uint32_t num, uint16_t type)
                 break;
             }
             case BLOCK: {
+                if(find_detached(num))break;
                 char* data = (char*)kmalloc(4097);
 //                Mem_used += 4097;
                 disk_read(num, (uint8_t*)data);
@@ -231,6 +265,8 @@ Mblock create_data(){
     mem->blockno = find_freeblock();
     mem->dirty = 1;
     mem->reclaim_count = 1;
+    mem->map_count = 0;
+    mem->next = NULL;
     add_cache(mem);
     return mem;
 }
@@ -286,6 +322,7 @@ int sfs_init(){//ok
     fs = (struct sfs_fs*)kmalloc(sizeof(struct sfs_fs));
 //    Mem_used += sizeof(sfs_fs);
     for(int i=0;i<256;i++)fs->hash[i] = NULL;
+    fs->detached = NULL;
     fs->size = 0;
     fs->super_dirty = 0;
     INODE root = (INODE)kmalloc(sizeof(struct sfs_inode));
@@ -303,7 +340,7 @@ int sfs_open(const char *path, uint32_t flags){//ok
     if(!fs)sfs_init();
     int i;
     for(i=0;i<16;i++){
-        if(!current->fs.fds[i])break;
+        if(!current->fs->fds[i])break;
     }
     if(i==16){
         printf("The process has opened so many files!\n");
@@ -341,20 +378,31 @@ int sfs_open(const char *path, uint32_t flags){//ok
     else if(!mem&&(flags&SFS_FLAG_WRITE)){
         mem = create_file(name, cur);
     }
-    current->fs.fds[i] = (struct file*)kmalloc(sizeof(struct file));
+    struct file* f = (struct file*)kmalloc(sizeof(struct file));
 //    Mem_used += sizeof(struct file);
-    current->fs.fds[i]->inode_no = mem->blockno;
-    current->fs.fds[i]->off = 0;
-    current->fs.fds[i]->flags = flags;
-    current->fs.fds[i]->inode = (INODE)kmalloc(sizeof(struct sfs_inode));
+    // 管道、共享内存的 fd 也用 struct file，type 不清零会被误认成它们
+    memset(f, 0, sizeof(struct file));
+    f->type = FILE_SFS;
+    f->inode_no = mem->blockno;
+    f->off = 0;
+    f->flags = flags;
+    f->inode = (INODE)kmalloc(sizeof(struct sfs_inode));
 //    Mem_used += sizeof(struct sfs_inode);
-    memcpy(current->fs.fds[i]->inode, mem->block.din, sizeof(struct sfs_inode));
-    return 0;
+    memcpy(f->inode, mem->block.din, sizeof(struct sfs_inode));
+    // 前面的检查没有加锁，同一张 fd 表的其他线程可能已经用掉了空闲的 fd
+    i = fd_install(current->fs, 0, f);
+    if(i<0){
+        printf("The process has opened so many files!\n");
+        kfree(f->inode);
+        kfree(f);
+    }
+    return i;
 }
 
 int sfs_close(int fd){
     if(!fs)sfs_init();
-    struct file* f = current->fs.fds[fd];
+    // 先从 fd 表中取下，两个线程同时关闭时只有一个会写回和释放
+    struct file* f = fd_remove(current->fs, fd, FILE_SFS);
     if(!f)return 1;
     if(f->inode->type){
         for(int i=2;i<f->inode->blocks;i++){
@@ -377,29 +425,28 @@ int sfs_close(int fd){
 //    Mem_used -= sizeof(sfs_inode);
     kfree(f);
 //    Mem_used -= sizeof(sfs_memory_block);
-    current->fs.fds[fd] = NULL;
 //    printf("Mem:%d\n",Mem_used);
     return 0;
 }
 
 int sfs_seek(int fd, int32_t off, int fromwhere){
     if(!fs)sfs_init();
-    uint32_t size = current->fs.fds[fd]->inode->size;
+    uint32_t size = current->fs->fds[fd]->inode->size;
     switch(fromwhere){
         case SEEK_SET: {
             if (off > size) {
                 printf("The offset beyond the file!\n");
                 return -1;
             }
-            current->fs.fds[fd]->off = off;
+            current->fs->fds[fd]->off = off;
             break;
         }
         case SEEK_CUR: {
-            if (current->fs.fds[fd]->off + off > size) {
+            if (current->fs->fds[fd]->off + off > size) {
                 printf("The offset beyond the file!\n");
                 return -1;
             }
-            current->fs.fds[fd]->off += off;
+            current->fs->fds[fd]->off += off;
             break;
         }
         case SEEK_END:{
@@ -407,7 +454,7 @@ int sfs_seek(int fd, int32_t off, int fromwhere){
                 printf("The offset beyond the file!\n");
                 return -1;
             }
-            current->fs.fds[fd]->off = size - off;
+            current->fs->fds[fd]->off = size - off;
             break;
         }
     }
@@ -416,7 +463,7 @@ int sfs_seek(int fd, int32_t off, int fromwhere){
 
 int sfs_read(int fd, char *buf, uint32_t len){
     if(!fs)sfs_init();
-    struct file* f = current->fs.fds[fd];
+    struct file* f = current->fs->fds[fd];
     if(!f){
         printf("There isn't a file!\n");
         return -1;
@@ -459,7 +506,7 @@ int sfs_read(int fd, char *buf, uint32_t len){
 
 int sfs_write(int fd, char *buf, uint32_t len){
     if(!fs)sfs_init();
-    struct file* f = current->fs.fds[fd];
+    struct file* f = current->fs->fds[fd];
     if(!f){
         printf("There isn't a file!\n");
         return 1;
@@ -515,6 +562,53 @@ int sfs_write(int fd, char *buf, uint32_t len){
     return len;
 }
 
+Mblock sfs_get_data_block(uint32_t inode_no, uint32_t index){
+    if(!fs)sfs_init();
+    Mblock cur = find_block(inode_no, DIN);
+    if((uint64_t)index * 4096 >= cur->block.din->size)return NULL;
+    while(index >= SFS_NDIRECT){
+        index -= SFS_NDIRECT;
+        if(!cur->block.din->indirect)return NULL;
+        cur = find_block(cur->block.din->indirect, DIN);
+    }
+    if(!cur->block.din->direct[index])return NULL;
+    return find_block(cur->block.din->direct[index], BLOCK);
+}
+
+uint32_t sfs_lookup(const char* path, uint32_t* size){
+    if(!fs)sfs_init();
+    if(path[0]!='/')return 0;
+    char name[SFS_MAX_FILENAME_LEN + 1];
+    Mblock cur = find_block(1, DIN);
+    int lst = 1;
+    for(int i = 1; ; i++){
+        if(path[i]!='/'&&path[i]!='\0')continue;
+        int len = i - lst;
+        if(len == 0 || len > SFS_MAX_FILENAME_LEN)return 0;
+        for(int j=0;j<len;j++)name[j]=path[lst+j];
+        name[len]='\0';
+        cur = find_file(name, cur);
+        if(!cur)return 0;
+        if(path[i]=='\0')break;
+        lst = i+1;
+    }
+    if(cur->block.din->type)return 0;
+    *size = cur->block.din->size;
+    return cur->blockno;
+}
+
+void sfs_unmap_block(Mblock mem){
+    if(--mem->map_count)return;
+    if(fs->hash[mem->blockno%256] == mem)return;
+    // 已被挤出 hash：从 detached 链表摘下，写回后释放
+    Mblock* link = &fs->detached;
+    while(*link && *link != mem)link = &(*link)->next;
+    if(*link)*link = mem->next;
+    if(mem->dirty)disk_write(mem->blockno, mem->block.block);
+    kfree(mem->block.block);
+    kfree(mem);
+}
+
 int sfs_get_files(const char* path, char* files[]){
     if(!fs)sfs_init();
     int size = strsize(path), lst=1, num=0;
@@ -526,9 +620,9 @@ int sfs_get_files(const char* path, char* files[]){
     for(int i = 1; i < size; i++){
         if(path[i]=='/'){
             int len = i - lst;
-            char* name = (char*)kmalloc(len);
+            char* name = (char*)kmalloc(len+1);
 //            Mem_used += len;
-            memcpy(name, path[lst], len);
+            memcpy(name, &path[lst], len);
             name[len]='\0';
             cur = find_file(name, cur);
             if(!cur)return -1;
@@ -537,9 +631,9 @@ int sfs_get_files(const char* path, char* files[]){
     }
     int len = size - lst;
     if(len){
-        char* name = (char*)kmalloc(len);
+        char* name = (char*)kmalloc(len+1);
 //        Mem_used += len;
-        memcpy(name, path[lst], len);
+        memcpy(name, &path[lst], len);
         name[len]='\0';
         cur = find_file(name, cur);
         if(!cur)return -1;
@@ -549,9 +643,7 @@ int sfs_get_files(const char* path, char* files[]){
             for(int i=0;i<cur->block.din->blocks;i++){
                 Mblock mem = find_block(cur->block.din->direct[i], DEN);
                 int s = strsize(mem->block.den->filename);
-                files[num] = (char*)kmalloc(s);
-//                Mem_used += s;
-                memcpy(files[num], mem->block.den->filename, s);
+                if(files)memcpy(files[num], mem->block.den->filename, s);
                 num++;
             }
             cur = find_block(cur->block.din->indirect, DIN);
@@ -559,7 +651,7 @@ int sfs_get_files(const char* path, char* files[]){
         for(int i=0;i<cur->block.din->blocks;i++){
             Mblock mem = find_block(cur->block.din->direct[i], DEN);
             int s = strsize(mem->block.den->filename);
-            memcpy(files[num], mem->block.den->filename, s);
+            if(files)memcpy(files[num], mem->block.den->filename, s);
             num++;
         }
         return num;
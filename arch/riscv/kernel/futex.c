@@ -0,0 +1,106 @@
+#include "futex.h"
+#include "list.h"
+#include "mm.h"
+#include "sched.h"
+#include "spinlock.h"
+#include "task_manager.h"
+#include "vm.h"
+
+struct futex_bucket {
+  struct spinlock lock;
+  struct list_head chain;
+};
+
+// 在内核栈上，由 futex_wake 从桶中摘下
+struct futex_q {
+  struct list_head list;
+  struct task_struct *task;
+  uint64_t key;
+  bool woken;
+};
+
+static struct futex_bucket futex_queues[FUTEX_HASH_SIZE];
+
+void futex_init(void) {
+  for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+    spin_lock_init(&futex_queues[i].lock);
+    INIT_LIST_HEAD(&futex_queues[i].chain);
+  }
+}
+
+// 返回 uaddr 的物理地址，内核通过它读取 *uaddr，不会因为其他线程 munmap 而缺页
+static uint64_t futex_key(uint32_t *uaddr) {
+  uint64_t addr = (uint64_t)uaddr;
+  if (addr % sizeof(uint32_t) || fault_in_user(addr, sizeof(uint32_t), 0)) {
+    return 0;
+  }
+  spin_lock(&current->mm->lock);
+  uint64_t pte = get_pte(current_pgtbl(), addr);
+  spin_unlock(&current->mm->lock);
+  if (!(pte & PTE_V)) {
+    return 0;
+  }
+  return ((pte >> 10) << 12) + addr % PAGE_SIZE;
+}
+
+static struct futex_bucket *hash_futex(uint64_t key) {
+  return &futex_queues[(key >> 2) % FUTEX_HASH_SIZE];
+}
+
+long futex_wait(uint32_t *uaddr, uint32_t val) {
+  uint64_t key = futex_key(uaddr);
+  if (key == 0) {
+    return -1;
+  }
+  struct futex_bucket *hb = hash_futex(key);
+  struct futex_q q;
+  q.task = current;
+  q.key = key;
+  q.woken = 0;
+
+  spin_lock(&hb->lock);
+  if (__atomic_load_n((uint32_t *)key, __ATOMIC_RELAXED) != val) {
+    spin_unlock(&hb->lock);
+    return -1;
+  }
+  list_add_tail(&q.list, &hb->chain);
+  current->state = TASK_INTERRUPTIBLE;
+  spin_unlock(&hb->lock);
+
+  // 若在这之前已被唤醒，state 已恢复为 TASK_RUNNING，schedule 直接返回
+  schedule(0);
+
+  spin_lock(&hb->lock);
+  if (!q.woken) {
+    list_del(&q.list);
+  }
+  spin_unlock(&hb->lock);
+  return 0;
+}
+
+long futex_wake(uint32_t *uaddr, uint32_t n) {
+  uint64_t key = futex_key(uaddr);
+  if (key == 0) {
+    return -1;
+  }
+  struct futex_bucket *hb = hash_futex(key);
+  struct futex_q *q, *tmp;
+  long woken = 0;
+
+  spin_lock(&hb->lock);
+  list_for_each_entry_safe(q, tmp, &hb->chain, list) {
+    if (woken >= n) {
+      break;
+    }
+    if (q->key != key) {
+      continue;
+    }
+    // 等待者拿到桶锁之前 q 一直有效
+    list_del(&q->list);
+    q->woken = 1;
+    wake_up_process(q->task);
+    woken++;
+  }
+  spin_unlock(&hb->lock);
+  return woken;
+}
@@ -0,0 +1,217 @@
+#include "io_uring.h"
+#include "fs.h"
+#include "mm.h"
+#include "slub.h"
+#include "syscall.h"
+#include "task_manager.h"
+#include "vm.h"
+
+long io_uring_setup(uint64_t addr, uint32_t entries, uint32_t flags) {
+  struct mm_struct *mm = current->mm;
+  if (mm->uring || entries == 0 || entries > IORING_MAX_ENTRIES ||
+      (entries & (entries - 1)) || addr % PAGE_SIZE) {
+    return -1;
+  }
+
+  uint64_t sq_off = sizeof(struct io_rings);
+  uint64_t cq_off = sq_off + entries * sizeof(struct io_uring_sqe);
+  uint64_t size = ROUNDUP(cq_off + 2 * entries * sizeof(struct io_uring_cqe), PAGE_SIZE);
+  // 环的页是立即以 PTE_U 映射的，不能落在内核、设备或用户栈所在的地址上
+  if (addr < USER_HEAP_START || addr > USER_MMAP_END - size) {
+    return -1;
+  }
+
+  struct io_ring_ctx *ctx = kmalloc(sizeof(struct io_ring_ctx));
+  struct vm_area_struct *vma = kmalloc(sizeof(struct vm_area_struct));
+  uint64_t pa = alloc_pages(size / PAGE_SIZE);
+  if (ctx == NULL || vma == NULL || pa == 0) {
+    if (ctx) kfree(ctx);
+    if (vma) kfree(vma);
+    if (pa) free_pages(pa);
+    return -1;
+  }
+  memset((void *)pa, 0, size);
+
+  struct io_rings *rings = (struct io_rings *)pa;
+  rings->sq_entries = entries;
+  rings->sq_mask = entries - 1;
+  rings->cq_entries = 2 * entries;
+  rings->cq_mask = 2 * entries - 1;
+  rings->flags = flags;
+  rings->sq_off = sq_off;
+  rings->cq_off = cq_off;
+
+  ctx->rings = rings;
+  ctx->sqes = (struct io_uring_sqe *)(pa + sq_off);
+  ctx->cqes = (struct io_uring_cqe *)(pa + cq_off);
+  ctx->sq_mask = entries - 1;
+  ctx->cq_mask = 2 * entries - 1;
+  ctx->cq_entries = 2 * entries;
+  ctx->user_addr = addr;
+  ctx->size = size;
+  ctx->flags = flags;
+  spin_lock_init(&ctx->lock);
+  init_waitqueue_head(&ctx->wait);
+  ctx->busy = 0;
+  ctx->dead = 0;
+  ctx->refs = 1;
+
+  // 已映射的匿名 VMA，但页属于 ctx，解除映射时不随 VMA 释放，见 io_uring_release
+  vma->vm_start = addr;
+  vma->vm_end = addr + size;
+  vma->vm_flags = PTE_V | PTE_R | PTE_W | PTE_U;
+  vma->mapped = 1;
+  vma->vm_mmap_flags = MAP_SHARED | MAP_ANONYMOUS | VM_URING;
+  vma->vm_ino = 0;
+  vma->vm_pgoff = 0;
+  vma->vm_pages = NULL;
+  vma->vm_shm = NULL;
+
+  // 同一地址空间的其他线程可能同时在 mmap 或创建环
+  spin_lock(&mm->lock);
+  struct vm_area_struct *next = find_vma_next(mm, addr);
+  if (mm->uring || (next && next != mm->vm && next->vm_start < addr + size)) {
+    spin_unlock(&mm->lock);
+    kfree(ctx);
+    kfree(vma);
+    free_pages(pa);
+    return -1;
+  }
+  insert_vma(mm, vma);
+  create_mapping(current_pgtbl(), addr, pa, size, vma->vm_flags);
+  mm->uring = ctx;
+  spin_unlock(&mm->lock);
+  return size;
+}
+
+// 与系统调用走同一个入口：管道、共享内存 fd 的分发，fs_lock 和用户内存的缺页处理都在里面
+static int64_t io_issue_sqe(struct io_uring_sqe *sqe) {
+  uint64_t *args = sqe->args;
+  switch (sqe->opcode) {
+  case SFS_OPEN:
+  case SFS_CLOSE:
+  case SFS_SEEK:
+  case SFS_READ:
+  case SFS_WRITE:
+  case SFS_GET_FILES:
+    return sys_call_table[sqe->opcode](args[0], args[1], args[2], 0, 0, 0);
+  default:
+    return -1;
+  }
+}
+
+static void io_ring_put(struct io_ring_ctx *ctx) {
+  if (__atomic_sub_fetch(&ctx->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    free_pages((uint64_t)ctx->rings);
+    kfree(ctx);
+  }
+}
+
+// 取得 current 地址空间的环的引用，没有环时返回 NULL
+static struct io_ring_ctx *io_ring_get(void) {
+  struct mm_struct *mm = current->mm;
+  spin_lock(&mm->lock);
+  struct io_ring_ctx *ctx = mm->uring;
+  if (ctx) {
+    __atomic_add_fetch(&ctx->refs, 1, __ATOMIC_RELAXED);
+  }
+  spin_unlock(&mm->lock);
+  return ctx;
+}
+
+// 依次处理 SQ 中的请求，CQ 满时停止，剩下的留给下一次。
+// 调用者已经是这个环唯一的提交者（ctx->busy）
+static long io_submit_sqes(struct io_ring_ctx *ctx, uint32_t to_submit) {
+  struct io_rings *rings = ctx->rings;
+  uint32_t head = rings->sq_head;
+  uint32_t tail = __atomic_load_n(&rings->sq_tail, __ATOMIC_ACQUIRE);
+  uint32_t cq_tail = rings->cq_tail;
+  long nr = 0;
+
+  if (tail - head < to_submit) {
+    to_submit = tail - head;
+  }
+  if (to_submit == 0) {
+    return 0;
+  }
+
+  while (nr < to_submit) {
+    uint32_t cq_head = __atomic_load_n(&rings->cq_head, __ATOMIC_ACQUIRE);
+    if (cq_tail - cq_head >= ctx->cq_entries) {
+      break;
+    }
+    // SQE 在用户可写的页里，先拷贝出来，执行过程中用户改写它也没有影响
+    struct io_uring_sqe sqe = ctx->sqes[head & ctx->sq_mask];
+    int64_t res = io_issue_sqe(&sqe);
+    struct io_uring_cqe *cqe = &ctx->cqes[cq_tail & ctx->cq_mask];
+    cqe->user_data = sqe.user_data;
+    cqe->res = res;
+    head++;
+    cq_tail++;
+    nr++;
+  }
+
+  __atomic_store_n(&rings->sq_head, head, __ATOMIC_RELEASE);
+  __atomic_store_n(&rings->cq_tail, cq_tail, __ATOMIC_RELEASE);
+  return nr;
+}
+
+// 成为环的提交者后处理 SQ。wait 为 0 时不等待，已有提交者就直接返回（时钟中断中不能睡眠）
+static long io_ring_submit(struct io_ring_ctx *ctx, uint32_t to_submit, bool wait) {
+  long nr = 0;
+  spin_lock(&ctx->lock);
+  while (ctx->busy && wait) {
+    sleep_on_locked(&ctx->wait, &ctx->lock);
+  }
+  if (ctx->busy || ctx->dead) {
+    nr = ctx->dead ? -1 : 0;
+    spin_unlock(&ctx->lock);
+    return nr;
+  }
+  ctx->busy = 1;
+  spin_unlock(&ctx->lock);
+
+  nr = io_submit_sqes(ctx, to_submit);
+
+  spin_lock(&ctx->lock);
+  ctx->busy = 0;
+  wake_up(&ctx->wait);
+  spin_unlock(&ctx->lock);
+  return nr;
+}
+
+long io_uring_enter(uint32_t to_submit) {
+  struct io_ring_ctx *ctx = io_ring_get();
+  if (ctx == NULL) {
+    return -1;
+  }
+  long nr = io_ring_submit(ctx, to_submit, 1);
+  io_ring_put(ctx);
+  return nr;
+}
+
+void io_uring_sqpoll(void) {
+  if (current->mm == NULL || current->mm->uring == NULL) {
+    return;
+  }
+  struct io_ring_ctx *ctx = io_ring_get();
+  if (ctx) {
+    if (ctx->flags & IORING_SETUP_SQPOLL) {
+      io_ring_submit(ctx, IORING_MAX_ENTRIES, 0);
+    }
+    io_ring_put(ctx);
+  }
+}
+
+void io_uring_release(struct mm_struct *mm) {
+  struct io_ring_ctx *ctx = mm->uring;
+  if (ctx == NULL) {
+    return;
+  }
+  mm->uring = NULL;
+  // 正在提交的线程会处理完手上这一批，之后的提交都会失败
+  spin_lock(&ctx->lock);
+  ctx->dead = 1;
+  spin_unlock(&ctx->lock);
+  io_ring_put(ctx);
+}
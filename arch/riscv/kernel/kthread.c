@@ -0,0 +1,67 @@
+#include "kthread.h"
+#include "mm.h"
+#include "riscv.h"
+#include "sched.h"
+#include "smp.h"
+#include "task_manager.h"
+#include "tlb.h"
+#include "vm.h"
+
+extern uint64_t _end;
+
+struct task_struct *kthread_create(int (*fn)(void *), void *arg,
+                                   const char *name) {
+  struct task_struct *p = alloc_task();
+  if (p == NULL) {
+    return NULL;
+  }
+  p->state = TASK_INTERRUPTIBLE;
+  p->priority = DEFAULT_PRIO;
+  p->counter = task_timeslice(p);
+  p->policy = SCHED_PRIO;
+  p->nice = 0;
+  p->flags = PF_KTHREAD;
+  link_child(p, NULL);
+
+  int i;
+  for (i = 0; i < TASK_COMM_LEN - 1 && name[i]; i++) {
+    p->comm[i] = name[i];
+  }
+  p->comm[i] = '\0';
+
+  // 使用 paging_init 建立的内核页表，根页表位于 _end
+  p->satp = (PHYSICAL_ADDR((uint64_t)&_end) >> 12) | SATP_MODE_SV39;
+  p->sscratch = 0;
+
+  // ret_from_kthread 从 s0、s1 中取出 fn 和 arg
+  p->thread.sp = TASK_STACK_TOP(p);
+  p->thread.ra = (uint64_t)ret_from_kthread;
+  p->thread.s0 = (uint64_t)fn;
+  p->thread.s1 = (uint64_t)arg;
+  return p;
+}
+
+struct task_struct *kthread_run(int (*fn)(void *), void *arg,
+                                const char *name) {
+  struct task_struct *p = kthread_create(fn, arg, name);
+  if (p) {
+    wake_up_process(p);
+  }
+  return p;
+}
+
+void kthread_exit(int code) {
+  exit_notify(code);
+  schedule(0);
+}
+
+// 内核态不响应中断，这里手动处理挂起的时钟中断和 IPI
+void cond_resched(void) {
+  if (read_csr(sip) & SIP_STIP) {
+    timer_interrupt();
+  }
+  ipi_poll();
+  if (need_resched) {
+    preempt_schedule();
+  }
+}
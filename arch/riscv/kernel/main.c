@@ -3,19 +3,39 @@
 #include "sched.h"
 #include "mm.h"
 #include "virtio.h"
+#include "tlb.h"
+#include "timer.h"
+#include "smp.h"
+#include "vdso.h"
+#include "workqueue.h"
+#include "console.h"
+#include "futex.h"
 
 int start_kernel() {
+  // head.S 中 tp 为 hartid，hart 0 负责全部初始化
+  cpu_init(0);
+  cpu_online_mask = 1;
+
   puts("ZJU OSLAB 7 3210105812 3210106333 居圣桐 詹含蓓\n");
   
   slub_init();
+  asid_init();
+  sched_init();
+  vdso_init();
+  futex_init();
   task_init();
+  workqueue_init();
   plic_init();
+  console_init();
   virtio_disk_init();
 
   // 设置第一次时钟中断
-  asm volatile("ecall");
-  
+  timer_init();
+
+  // 放行其他 hart，它们各自进入 idle 后从 hart 0 拉取进程
+  smp_boot_secondaries();
+
   call_first_process();
-  dead_loop();
+  cpu_idle();
   return 0;
 }
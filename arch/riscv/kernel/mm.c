@@ -1,6 +1,7 @@
 #include "mm.h"
 
 #include "vm.h"
+#include "spinlock.h"
 #include "stdio.h"
 
 #define set_split(x) ((unsigned int)(x) | 0x80000000)
@@ -8,6 +9,12 @@
 #define get_size(x) set_unsplit(x)
 #define check_split(x) ((unsigned int)(x) & 0x80000000)
 
+// 所有 hart 共用一个 buddy system
+static struct spinlock buddy_lock = SPINLOCK_INIT;
+
+// 每个物理页的引用计数，只有 get_page 过的页才使用，见 mm.h
+static uint32_t page_refs[MEMORY_SIZE / PAGE_SIZE];
+
 uint64_t get_index(uint64_t va) {
   uint64_t offset = (va - buddy_system.base_addr) / PAGE_SIZE;
   int block_size = 1;
@@ -112,6 +119,7 @@ uint64_t alloc_buddy(int index, unsigned int num) {
 
 uint64_t alloc_pages(unsigned int num) {
   // 分配num个页面，返回分配到的页面的首地址，如果没有足够的空闲页面，返回0
+  spin_lock(&buddy_lock);
   if (!buddy_system.initialized) {
     init_buddy_system();
   }
@@ -124,6 +132,7 @@ uint64_t alloc_pages(unsigned int num) {
     i *= 2;
   }
   uint64_t addr = alloc_buddy(1, i);
+  spin_unlock(&buddy_lock);
 
   return addr;
 }
@@ -162,17 +171,31 @@ void free_pages(uint64_t pa) {
   // 注意，如果该节点的状态为已经被拆分，则应该释放其左子节点
   // 提示：使用get_index函数可以获取pa对应的最上层节点的下标
 
+  spin_lock(&buddy_lock);
   int index = get_index(pa);
   while(check_split(buddy_system.bitmap[index])) {
     index *= 2;
   }
   free_buddy(index);
+  spin_unlock(&buddy_lock);
 
 
   return;
 
 }
 
+void get_page(uint64_t pa) {
+  uint64_t index = (pa - buddy_system.base_addr) / PAGE_SIZE;
+  __atomic_add_fetch(&page_refs[index], 1, __ATOMIC_RELAXED);
+}
+
+void put_page(uint64_t pa) {
+  uint64_t index = (pa - buddy_system.base_addr) / PAGE_SIZE;
+  if (__atomic_sub_fetch(&page_refs[index], 1, __ATOMIC_ACQ_REL) == 0) {
+    free_pages(pa);
+  }
+}
+
 void memcpy(void * dst, void * src, size_t size) {
   char * a = dst;
   char * b = src;
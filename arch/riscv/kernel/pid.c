@@ -0,0 +1,63 @@
+#include "pid.h"
+#include "bitops.h"
+#include "list.h"
+#include "task_manager.h"
+
+// 位图记录已分配的 pid。分配时从 last_pid 之后按 64 位一组查找，
+// 刚释放的 pid 不会马上被复用
+static uint64_t pid_map[PID_MAX / 64];
+static long last_pid = -1;
+
+static struct list_head pid_hash[PIDHASH_SZ];
+static bool pid_hash_ready;
+
+#define pid_hashfn(pid) ((uint64_t)(pid) % PIDHASH_SZ)
+
+long alloc_pid(void) {
+  long pid = last_pid + 1;
+  for (int i = 0; i <= PID_MAX / 64; i++) {
+    if (pid >= PID_MAX) {
+      pid = 0;
+    }
+    uint64_t avail = ~pid_map[pid / 64] & (~0UL << (pid % 64));
+    if (avail) {
+      pid = pid / 64 * 64 + __ffs(avail);
+      pid_map[pid / 64] |= 1UL << (pid % 64);
+      last_pid = pid;
+      return pid;
+    }
+    pid = (pid / 64 + 1) * 64;
+  }
+  return -1;
+}
+
+void free_pid(long pid) {
+  pid_map[pid / 64] &= ~(1UL << (pid % 64));
+}
+
+void attach_pid(struct task_struct *p) {
+  if (!pid_hash_ready) {
+    for (int i = 0; i < PIDHASH_SZ; i++) {
+      INIT_LIST_HEAD(&pid_hash[i]);
+    }
+    pid_hash_ready = 1;
+  }
+  list_add(&p->pid_chain, &pid_hash[pid_hashfn(p->pid)]);
+}
+
+void detach_pid(struct task_struct *p) {
+  list_del_init(&p->pid_chain);
+}
+
+struct task_struct *find_task_by_pid(long pid) {
+  if (pid < 0 || !pid_hash_ready) {
+    return NULL;
+  }
+  struct task_struct *p;
+  list_for_each_entry(p, &pid_hash[pid_hashfn(pid)], pid_chain) {
+    if (p->pid == pid) {
+      return p;
+    }
+  }
+  return NULL;
+}
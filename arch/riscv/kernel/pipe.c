@@ -0,0 +1,392 @@
+#include "pipe.h"
+#include "fs.h"
+#include "mm.h"
+#include "sched.h"
+#include "slub.h"
+#include "task_manager.h"
+#include "tlb.h"
+#include "vm.h"
+
+#define pipe_empty(pipe) ((pipe)->head == (pipe)->tail)
+#define pipe_full(pipe) ((pipe)->head - (pipe)->tail >= PIPE_BUFFERS)
+
+static struct file *alloc_pipe_file(struct pipe *pipe, uint64_t flags) {
+  struct file *f = kmalloc(sizeof(struct file));
+  if (f) {
+    memset(f, 0, sizeof(struct file));
+    f->type = FILE_PIPE;
+    f->pipe = pipe;
+    f->flags = flags;
+    f->refs = 1;
+  }
+  return f;
+}
+
+long do_pipe(int *fds) {
+  if (fault_in_user((uint64_t)fds, 2 * sizeof(int), 1)) {
+    return -1;
+  }
+  struct pipe *pipe = kmalloc(sizeof(struct pipe));
+  struct file *rf = alloc_pipe_file(pipe, SFS_FLAG_READ);
+  struct file *wf = alloc_pipe_file(pipe, SFS_FLAG_WRITE);
+  if (pipe == NULL || rf == NULL || wf == NULL) {
+    if (pipe) kfree(pipe);
+    if (rf) kfree(rf);
+    if (wf) kfree(wf);
+    return -1;
+  }
+  spin_lock_init(&pipe->lock);
+  init_waitqueue_head(&pipe->rd_wait);
+  init_waitqueue_head(&pipe->wr_wait);
+  pipe->head = pipe->tail = 0;
+  pipe->readers = pipe->writers = 1;
+
+  // 0、1 留给控制台，见 sys_read、sys_write。两个 fd 要么都装入，要么都不装入
+  struct files_struct *files = current->fs;
+  int rfd = -1, wfd = -1;
+  spin_lock(&files->lock);
+  for (int fd = 2; fd < 16 && wfd < 0; fd++) {
+    if (!files->fds[fd]) {
+      if (rfd < 0) {
+        rfd = fd;
+      } else {
+        wfd = fd;
+      }
+    }
+  }
+  if (wfd >= 0) {
+    files->fds[rfd] = rf;
+    files->fds[wfd] = wf;
+  }
+  spin_unlock(&files->lock);
+  if (wfd < 0) {
+    kfree(pipe);
+    kfree(rf);
+    kfree(wf);
+    return -1;
+  }
+  fds[0] = rfd;
+  fds[1] = wfd;
+  return 0;
+}
+
+struct file *fget_pipe(int fd) {
+  return fget(current->fs, fd, FILE_PIPE);
+}
+
+long pipe_read(struct file *f, char *buf, uint64_t count) {
+  struct pipe *pipe = f->pipe;
+  uint64_t done = 0;
+  if (!(f->flags & SFS_FLAG_READ)) {
+    return -1;
+  }
+  if (count == 0) {
+    return 0;
+  }
+  if (fault_in_user((uint64_t)buf, count, 1)) {
+    return -1;
+  }
+
+  spin_lock(&pipe->lock);
+  while (pipe_empty(pipe)) {
+    if (pipe->writers == 0) {
+      spin_unlock(&pipe->lock);
+      return 0;
+    }
+    sleep_on_locked(&pipe->rd_wait, &pipe->lock);
+  }
+  while (done < count && !pipe_empty(pipe)) {
+    struct pipe_buffer *b = &pipe->bufs[pipe->tail % PIPE_BUFFERS];
+    uint64_t n = min(b->len, count - done);
+    memcpy(buf + done, (void *)(b->page + b->offset), n);
+    b->offset += n;
+    b->len -= n;
+    done += n;
+    if (b->len == 0) {
+      free_pages(b->page);
+      pipe->tail++;
+    }
+  }
+  wake_up(&pipe->wr_wait);
+  spin_unlock(&pipe->lock);
+  return done;
+}
+
+long pipe_write(struct file *f, const char *buf, uint64_t count) {
+  struct pipe *pipe = f->pipe;
+  uint64_t done = 0;
+  if (!(f->flags & SFS_FLAG_WRITE)) {
+    return -1;
+  }
+  if (count == 0) {
+    return 0;
+  }
+  if (fault_in_user((uint64_t)buf, count, 0)) {
+    return -1;
+  }
+
+  spin_lock(&pipe->lock);
+  while (done < count && pipe->readers) {
+    struct pipe_buffer *last = NULL;
+    uint64_t room = 0;
+    if (!pipe_empty(pipe)) {
+      last = &pipe->bufs[(pipe->head - 1) % PIPE_BUFFERS];
+      room = PAGE_SIZE - last->offset - last->len;
+    }
+    if (room == 0) {
+      if (pipe_full(pipe)) {
+        wake_up(&pipe->rd_wait);
+        sleep_on_locked(&pipe->wr_wait, &pipe->lock);
+        continue;
+      }
+      uint64_t page = alloc_page();
+      if (page == 0) {
+        break;
+      }
+      last = &pipe->bufs[pipe->head++ % PIPE_BUFFERS];
+      last->page = page;
+      last->offset = 0;
+      last->len = 0;
+      room = PAGE_SIZE;
+    }
+    uint64_t n = min(room, count - done);
+    memcpy((void *)(last->page + last->offset + last->len), (void *)(buf + done), n);
+    last->len += n;
+    done += n;
+  }
+  if (done) {
+    wake_up(&pipe->rd_wait);
+  }
+  spin_unlock(&pipe->lock);
+  return done ? (long)done : -1;
+}
+
+// 可以整页搬运的用户页：私有匿名、逐页分配的区域（如堆），每一页都只属于这个地址空间。
+// 调用者持有 mm->lock
+static struct vm_area_struct *splice_vma(uint64_t va) {
+  struct vm_area_struct *vma = find_vma(current->mm, va);
+  if (vma == NULL || vma->vm_pages || !(vma->vm_mmap_flags & VM_PAGED) ||
+      (vma->vm_mmap_flags & MAP_SHARED) || !(vma->vm_flags & PTE_U) ||
+      !(vma->vm_flags & PTE_W)) {
+    return NULL;
+  }
+  return vma;
+}
+
+// 把用户的整页挂进管道，用户那一页解除映射
+static long vmsplice_to_pipe(struct file *f, uint64_t addr, uint64_t len) {
+  struct pipe *pipe = f->pipe;
+  uint64_t *pgtbl = current_pgtbl();
+  uint64_t done = 0;
+
+  while (done < len) {
+    uint64_t va = addr + done;
+    uint64_t pte = 0;
+    if (va % PAGE_SIZE == 0 && len - done >= PAGE_SIZE) {
+      spin_lock(&current->mm->lock);
+      pte = splice_vma(va) ? get_pte(pgtbl, va) : 0;
+      spin_unlock(&current->mm->lock);
+    }
+    if (!(pte & PTE_V)) {
+      // 不能整页搬运的部分照常拷贝，一次到下一个页边界为止
+      uint64_t n = min(ROUNDDOWN(va, PAGE_SIZE) + PAGE_SIZE - va, len - done);
+      long ret = pipe_write(f, (const char *)va, n);
+      if (ret <= 0) {
+        return done ? (long)done : ret;
+      }
+      done += ret;
+      continue;
+    }
+
+    spin_lock(&pipe->lock);
+    while (pipe->readers && pipe_full(pipe)) {
+      wake_up(&pipe->rd_wait);
+      sleep_on_locked(&pipe->wr_wait, &pipe->lock);
+    }
+    if (pipe->readers == 0) {
+      spin_unlock(&pipe->lock);
+      return done ? (long)done : -1;
+    }
+    spin_lock(&current->mm->lock);
+    // 等待期间其他线程可能改变了这一页的映射，重新检查
+    if (!splice_vma(va) || get_pte(pgtbl, va) != pte) {
+      spin_unlock(&current->mm->lock);
+      spin_unlock(&pipe->lock);
+      continue;
+    }
+    struct pipe_buffer *b = &pipe->bufs[pipe->head++ % PIPE_BUFFERS];
+    b->page = (pte >> 10) << 12;
+    b->offset = 0;
+    b->len = PAGE_SIZE;
+    create_mapping(pgtbl, va, 0, PAGE_SIZE, 0);
+    flush_tlb_page(current->mm, va);
+    spin_unlock(&current->mm->lock);
+    wake_up(&pipe->rd_wait);
+    spin_unlock(&pipe->lock);
+    done += PAGE_SIZE;
+  }
+  return done;
+}
+
+// 把管道中的整页直接映射到用户地址，用户原来的页释放
+static long vmsplice_from_pipe(struct file *f, uint64_t addr, uint64_t len) {
+  struct pipe *pipe = f->pipe;
+  uint64_t *pgtbl = current_pgtbl();
+  uint64_t done = 0;
+
+  while (done < len) {
+    uint64_t va = addr + done;
+    bool whole = va % PAGE_SIZE == 0 && len - done >= PAGE_SIZE;
+
+    spin_lock(&pipe->lock);
+    while (pipe_empty(pipe)) {
+      // 已经读到了数据就先返回，与 read 一致
+      if (done || pipe->writers == 0) {
+        spin_unlock(&pipe->lock);
+        return done;
+      }
+      sleep_on_locked(&pipe->rd_wait, &pipe->lock);
+    }
+    struct pipe_buffer *b = &pipe->bufs[pipe->tail % PIPE_BUFFERS];
+    struct vm_area_struct *vma = NULL;
+    if (whole && b->offset == 0 && b->len == PAGE_SIZE) {
+      spin_lock(&current->mm->lock);
+      vma = splice_vma(va);
+      if (vma == NULL) {
+        spin_unlock(&current->mm->lock);
+      }
+    }
+    if (vma) {
+      uint64_t old = get_pte(pgtbl, va);
+      create_mapping(pgtbl, va, b->page, PAGE_SIZE, vma->vm_flags);
+      flush_tlb_page(current->mm, va);
+      if (old & PTE_V) {
+        free_pages((old >> 10) << 12);
+      }
+      vma->mapped = 1;
+      spin_unlock(&current->mm->lock);
+      pipe->tail++;
+      wake_up(&pipe->wr_wait);
+      spin_unlock(&pipe->lock);
+      done += PAGE_SIZE;
+      continue;
+    }
+    spin_unlock(&pipe->lock);
+
+    uint64_t n = min(ROUNDDOWN(va, PAGE_SIZE) + PAGE_SIZE - va, len - done);
+    long ret = pipe_read(f, (char *)va, n);
+    if (ret <= 0) {
+      return done ? (long)done : ret;
+    }
+    done += ret;
+    if ((uint64_t)ret < n) {
+      break;
+    }
+  }
+  return done;
+}
+
+long pipe_vmsplice(struct file *f, uint64_t addr, uint64_t len) {
+  if (f->flags & SFS_FLAG_WRITE) {
+    return vmsplice_to_pipe(f, addr, len);
+  }
+  return vmsplice_from_pipe(f, addr, len);
+}
+
+static struct file *pipe_dup(struct file *f) {
+  struct pipe *pipe = f->pipe;
+  struct file *nf = alloc_pipe_file(pipe, f->flags);
+  if (nf == NULL) {
+    return NULL;
+  }
+  spin_lock(&pipe->lock);
+  if (f->flags & SFS_FLAG_READ) {
+    pipe->readers++;
+  } else {
+    pipe->writers++;
+  }
+  spin_unlock(&pipe->lock);
+  return nf;
+}
+
+long do_dup2(int oldfd, int newfd) {
+  struct file *f = fget_pipe(oldfd);
+  if (f == NULL) {
+    return -1;
+  }
+  if (newfd < 0 || newfd >= 16 || newfd == oldfd) {
+    fput(f);
+    return newfd == oldfd ? newfd : -1;
+  }
+  struct file *nf = pipe_dup(f);
+  fput(f);
+  if (nf == NULL) {
+    return -1;
+  }
+  struct files_struct *files = current->fs;
+  spin_lock(&files->lock);
+  struct file *old = files->fds[newfd];
+  // SFS 文件关闭时要写回，这里只替换管道
+  if (old && old->type != FILE_PIPE) {
+    spin_unlock(&files->lock);
+    fput(nf);
+    return -1;
+  }
+  files->fds[newfd] = nf;
+  spin_unlock(&files->lock);
+  if (old) {
+    fput(old);
+  }
+  return newfd;
+}
+
+void pipe_close(struct file *f) {
+  struct pipe *pipe = f->pipe;
+  spin_lock(&pipe->lock);
+  if (f->flags & SFS_FLAG_READ) {
+    pipe->readers--;
+  } else {
+    pipe->writers--;
+  }
+  bool last = pipe->readers == 0 && pipe->writers == 0;
+  // 另一端可能在等待，让它看到 EOF 或读端已关闭
+  wake_up(&pipe->rd_wait);
+  wake_up(&pipe->wr_wait);
+  spin_unlock(&pipe->lock);
+  kfree(f);
+
+  if (last) {
+    while (!pipe_empty(pipe)) {
+      free_pages(pipe->bufs[pipe->tail++ % PIPE_BUFFERS].page);
+    }
+    kfree(pipe);
+  }
+}
+
+int copy_pipes(struct files_struct *dst, struct files_struct *src) {
+  int ret = 0;
+  // 持有 src->lock，复制过程中其他线程不能关闭这些管道
+  spin_lock(&src->lock);
+  for (int fd = 0; fd < 16; fd++) {
+    struct file *f = src->fds[fd];
+    if (f && f->type == FILE_PIPE) {
+      dst->fds[fd] = pipe_dup(f);
+      if (dst->fds[fd] == NULL) {
+        ret = -1;
+        break;
+      }
+    }
+  }
+  spin_unlock(&src->lock);
+  return ret;
+}
+
+void exit_pipes(struct files_struct *files) {
+  for (int fd = 0; fd < 16; fd++) {
+    struct file *f = files->fds[fd];
+    if (f && f->type == FILE_PIPE) {
+      files->fds[fd] = NULL;
+      fput(f);
+    }
+  }
+}
@@ -1,6 +1,29 @@
+#include "console.h"
 #include "defs.h"
+#include "spinlock.h"
 #include "stdio.h"
 
+// 多个 hart 同时输出时不让各自的字符交错在一起
+static struct spinlock print_lock = SPINLOCK_INIT;
+
+// printf 先格式化到这里，攒满或结束时整段放入输出环，由 print_lock 保护
+#define PRINT_BUF_SIZE 128
+static char print_buf[PRINT_BUF_SIZE];
+static uint64_t print_len;
+
+static void print_flush(void) {
+  console_write_atomic(print_buf, print_len);
+  print_len = 0;
+}
+
+static int print_putch(const char c) {
+  print_buf[print_len++] = c;
+  if (print_len == PRINT_BUF_SIZE) {
+    print_flush();
+  }
+  return (unsigned char)c;
+}
+
 int putchar(const char c) {
   *UART16550A_DR = (unsigned char)(c);
   return (unsigned char)c;
@@ -15,8 +38,12 @@ int getchar() {
 }
 
 int puts(const char *s) {
-  while (*s)
-    putchar(*s++);
+  uint64_t len = 0;
+  while (s[len])
+    len++;
+  spin_lock(&print_lock);
+  console_write_atomic(s, len);
+  spin_unlock(&print_lock);
   return 0;
 }
 
@@ -124,7 +151,10 @@ int printf(const char *s, ...) {
   int res = 0;
   va_list vl;
   va_start(vl, s);
-  res = vprintfmt(putchar, s, vl);
+  spin_lock(&print_lock);
+  res = vprintfmt(print_putch, s, vl);
+  print_flush();
+  spin_unlock(&print_lock);
   va_end(vl);
   return res;
 }
\ No newline at end of file
@@ -2,58 +2,511 @@
 #include "defs.h"
 #include "mm.h"
 #include "task_manager.h"
+#include "tlb.h"
+#include "timer.h"
+#include "bitops.h"
+#include "console.h"
+#include "fpu.h"
+#include "vdso.h"
+#include "riscv.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "stdio.h"
+
+struct runqueue runqueues[NR_CPUS];
+
+void sched_init(void) {
+  for (int i = 0; i < NR_CPUS; i++) {
+    struct runqueue *rq = cpu_rq(i);
+    spin_lock_init(&rq->lock);
+    rq->cpu = i;
+    rq->bitmap = 0;
+    rq->nr_running = 0;
+    for (int j = 0; j < MAX_PRIO; j++) {
+      INIT_LIST_HEAD(&rq->queue[j]);
+    }
+    rq->fair_root = RB_ROOT;
+    rq->nr_fair = 0;
+    rq->fair_load = 0;
+    rq->min_vruntime = 0;
+  }
+}
+
+// 锁住 p 所在的 runqueue。加锁前 p 可能被其他 hart 迁移走，所以加锁后要再确认一次
+static struct runqueue *task_rq_lock(struct task_struct *p) {
+  while (1) {
+    struct runqueue *rq = task_rq(p);
+    spin_lock(&rq->lock);
+    if (rq == task_rq(p)) {
+      return rq;
+    }
+    spin_unlock(&rq->lock);
+  }
+}
+
+static void __enqueue_task(struct runqueue *rq, struct task_struct *p) {
+  if (p->on_rq) {
+    return;
+  }
+  p->cpu = rq->cpu;
+  if (p->policy == SCHED_FAIR) {
+    enqueue_task_fair(rq, p);
+  } else {
+    list_add_tail(&p->run_list, &rq->queue[p->priority]);
+    rq->bitmap |= 1ULL << p->priority;
+  }
+  rq->nr_running++;
+  p->on_rq = 1;
+}
+
+static void __dequeue_task(struct runqueue *rq, struct task_struct *p) {
+  if (!p->on_rq) {
+    return;
+  }
+  if (p->policy == SCHED_FAIR) {
+    dequeue_task_fair(rq, p);
+  } else {
+    list_del_init(&p->run_list);
+    if (list_empty(&rq->queue[p->priority])) {
+      rq->bitmap &= ~(1ULL << p->priority);
+    }
+  }
+  rq->nr_running--;
+  p->on_rq = 0;
+}
+
+void enqueue_task(struct task_struct *p) {
+  struct runqueue *rq = task_rq_lock(p);
+  __enqueue_task(rq, p);
+  spin_unlock(&rq->lock);
+}
+
+void dequeue_task(struct task_struct *p) {
+  struct runqueue *rq = task_rq_lock(p);
+  __dequeue_task(rq, p);
+  spin_unlock(&rq->lock);
+}
+
+// 唤醒一个空闲的 hart，让它从 runqueue 较长的 hart 上拉取任务
+static void kick_idle_cpu(void) {
+  for_each_online_cpu(c) {
+    if (c != smp_processor_id() && cpus[c].curr == cpus[c].idle &&
+        cpu_rq(c)->nr_running == 0) {
+      send_ipi(1UL << c, IPI_RESCHEDULE);
+      return;
+    }
+  }
+}
+
+// p 刚加入 rq：若它应当抢占 rq 所在 hart 上正在运行的进程，通知该 hart 重新调度
+static void check_preempt_curr(struct runqueue *rq, struct task_struct *p) {
+  struct cpu *c = &cpus[rq->cpu];
+  struct task_struct *curr = c->curr;
+  // 启动阶段该 hart 还没有开始调度
+  if (curr == NULL) {
+    return;
+  }
+  bool preempt = curr == c->idle ||
+                 (p->policy == SCHED_PRIO &&
+                  (curr->policy == SCHED_FAIR || p->priority < curr->priority));
+  if (preempt) {
+    if (c == this_cpu()) {
+      c->resched = 1;
+    } else {
+      send_ipi(1UL << c->id, IPI_RESCHEDULE);
+    }
+  } else if (rq->nr_running >= 2) {
+    kick_idle_cpu();
+  }
+}
+
+// 新进程放到可运行进程最少的 hart 上，相同时优先留在本 hart
+static struct runqueue *select_task_rq(void) {
+  struct runqueue *best = this_rq();
+  for_each_online_cpu(c) {
+    if (cpu_rq(c)->nr_running < best->nr_running) {
+      best = cpu_rq(c);
+    }
+  }
+  return best;
+}
+
+void wake_up_new_task(struct task_struct *p) {
+  struct runqueue *rq = select_task_rq();
+  spin_lock(&rq->lock);
+  if (p->policy == SCHED_FAIR && rq != this_rq()) {
+    // 继承的 vruntime 是相对本 hart 的 min_vruntime 而言的
+    p->vruntime = p->vruntime - this_rq()->min_vruntime + rq->min_vruntime;
+  }
+  __enqueue_task(rq, p);
+  spin_unlock(&rq->lock);
+  check_preempt_curr(rq, p);
+}
+
+void set_task_prio(struct task_struct *p, long prio) {
+  if (prio < 0) {
+    prio = 0;
+  } else if (prio >= MAX_PRIO) {
+    prio = MAX_PRIO - 1;
+  }
+  struct runqueue *rq = task_rq_lock(p);
+  if (p->on_rq) {
+    __dequeue_task(rq, p);
+    p->priority = prio;
+    __enqueue_task(rq, p);
+  } else {
+    p->priority = prio;
+  }
+  spin_unlock(&rq->lock);
+}
+
+int sched_setscheduler(struct task_struct *p, int policy, long param) {
+  if (policy == SCHED_PRIO) {
+    if (param < 0 || param >= MAX_PRIO) {
+      return -1;
+    }
+  } else if (policy == SCHED_FAIR) {
+    if (param < MIN_NICE || param > MAX_NICE) {
+      return -1;
+    }
+  } else {
+    return -1;
+  }
+
+  struct runqueue *rq = task_rq_lock(p);
+  bool queued = p->on_rq;
+  if (queued) {
+    __dequeue_task(rq, p);
+  }
+  if (policy == SCHED_FAIR && p->policy != SCHED_FAIR) {
+    p->vruntime = rq->min_vruntime;
+    p->exec_start = rdtime();
+  }
+  p->policy = policy;
+  if (policy == SCHED_PRIO) {
+    p->priority = param;
+  } else {
+    p->nice = param;
+  }
+  if (queued) {
+    __enqueue_task(rq, p);
+  }
+  spin_unlock(&rq->lock);
+  return 0;
+}
+
+// 睡眠的进程放回它上次运行的 hart，那里的 TLB 中可能还有它的项
+void wake_up_process(struct task_struct *p) {
+  struct runqueue *rq = task_rq_lock(p);
+  if (p->state != TASK_INTERRUPTIBLE) {
+    spin_unlock(&rq->lock);
+    return;
+  }
+  p->state = TASK_RUNNING;
+  __enqueue_task(rq, p);
+  spin_unlock(&rq->lock);
+  // 被唤醒的进程优先级更高时，在返回用户态前抢占正在运行的进程
+  check_preempt_curr(rq, p);
+}
+
+void sleep_on_locked(struct wait_queue_head *wq, struct spinlock *lock) {
+  struct wait_queue_entry wait;
+  wait.task = current;
+
+  spin_lock(&wq->lock);
+  list_add_tail(&wait.entry, &wq->head);
+  current->state = TASK_INTERRUPTIBLE;
+  spin_unlock(&wq->lock);
+  if (lock) {
+    spin_unlock(lock);
+  }
+
+  // 若在这之前已被唤醒，state 已恢复为 TASK_RUNNING，schedule 不会把它移出 runqueue
+  schedule(0);
+
+  spin_lock(&wq->lock);
+  list_del(&wait.entry);
+  spin_unlock(&wq->lock);
+  if (lock) {
+    spin_lock(lock);
+  }
+}
+
+void sleep_on(struct wait_queue_head *wq) {
+  sleep_on_locked(wq, NULL);
+}
+
+void wake_up(struct wait_queue_head *wq) {
+  struct wait_queue_entry *wait;
+  spin_lock(&wq->lock);
+  list_for_each_entry(wait, &wq->head, entry) {
+    wake_up_process(wait->task);
+  }
+  spin_unlock(&wq->lock);
+}
 
 // If next==current,do nothing; else update current and call __switch_to.
 void switch_to(struct task_struct *next) {
-  if (current != next) {
-    struct task_struct *prev = current;
-    current = next;
-    __switch_to(prev, next);
+  struct cpu *c = this_cpu();
+  struct task_struct *prev = c->curr;
+  if (prev == next) {
+    return;
   }
+  // idle task 和内核线程沿用启动时的内核页表（ASID 0），不需要分配 ASID
+  if (next == c->idle || (next->flags & PF_KTHREAD)) {
+    switch_to_idle_mm();
+  } else {
+    check_and_switch_context(next);
+    // next 可能是从别的 hart 迁移过来的
+    *(struct cpu **)TASK_STACK_TOP(next) = c;
+  }
+  fp_switch_out(prev);
+  vvar_inc(prev, nr_switches);
+  c->prev = prev;
+  c->curr = next;
+  this_rq()->nr_switches++;
+  __switch_to(prev, next);
+  // 此时已经回到了 prev，可能在另一个 hart 上
+  finish_task_switch();
+}
+
+void finish_task_switch(void) {
+  struct cpu *c = this_cpu();
+  struct task_struct *prev = c->prev;
+  if (prev == NULL) {
+    return;
+  }
+  c->prev = NULL;
+  // 清除 on_cpu 之后 prev 随时可能被释放，state 要先读出来
+  bool dead = prev->state == TASK_DEAD;
+  __atomic_store_n(&prev->on_cpu, 0, __ATOMIC_RELEASE);
+  if (dead) {
+    schedule_reap();
+  }
+}
+
+// 启动流程本身成为本 hart 的 idle task，之后从 cpu_idle 继续运行
+void init_idle(void) {
+  struct cpu *c = this_cpu();
+  struct task_struct *idle = (struct task_struct*)alloc_page();
+  idle->pid = -1;
+  idle->state = TASK_RUNNING;
+  idle->counter = 0;
+  idle->priority = MAX_PRIO;
+  idle->policy = SCHED_PRIO;
+  idle->on_rq = 0;
+  idle->on_cpu = 1;
+  idle->cpu = c->id;
+  idle->mm = NULL;
+  idle->fs = NULL;
+  idle->vvar = NULL;
+  c->idle = idle;
+  c->curr = idle;
 }
 
 void call_first_process() {
-  current = (struct task_struct*)alloc_page();
-  current->pid = -1;
-  current->counter = 0;
-  current->priority = 0;
+  init_idle();
   schedule(0);
 }
 
-void do_timer(void) {
+// 内核线程一直存在，不算在内
+static int nr_live_tasks(void) {
+  int n = 0;
+  struct task_struct *p;
+  spin_lock(&tasklist_lock);
+  list_for_each_entry(p, &task_list, tasks) {
+    if (p->state != TASK_DEAD && p->state != TASK_ZOMBIE &&
+        !(p->flags & PF_KTHREAD)) {
+      n++;
+    }
+  }
+  spin_unlock(&tasklist_lock);
+  return n;
 }
 
-// Select the next task to run. If all tasks are done(counter=0), set task0's
-// counter to 1 and it would assign new test case.
-void schedule(bool self) {
-  unsigned char next = NR_TASKS;
+// 从 runqueue 中找一个可以迁移的进程：不能正在某个 hart 上运行
+static struct task_struct *pick_migratable_task(struct runqueue *rq) {
+  struct task_struct *p;
+  uint64_t bitmap = rq->bitmap;
+  while (bitmap) {
+    list_for_each_entry(p, &rq->queue[__ffs(bitmap)], run_list) {
+      if (!p->on_cpu) {
+        return p;
+      }
+    }
+    bitmap &= bitmap - 1;
+  }
+  for (struct rb_node *n = rb_first(&rq->fair_root); n; n = rb_next(n)) {
+    p = rb_entry(n, struct task_struct, run_node);
+    if (!p->on_cpu) {
+      return p;
+    }
+  }
+  return NULL;
+}
 
-  // DONE
-  int min = 0x7fffffff;
-  int min_p = 0x7fffffff;
-  for (int i = NR_TASKS - 1; i >= 0; i--) {
-    if (task[i] == 0x0) {
+// 本 hart 空闲时从其他 hart 的 runqueue 拉取一个等待运行的进程，成功返回 1。
+// 已持有本 hart 的锁时只 trylock 对方，两个 hart 互相拉取时不会死锁
+static bool idle_balance(void) {
+  struct runqueue *this = this_rq();
+  for_each_online_cpu(c) {
+    struct runqueue *src = cpu_rq(c);
+    if (src == this || src->nr_running < 2) {
       continue;
     }
-    if (!self && task[i] == current) {
+    spin_lock(&this->lock);
+    if (!spin_trylock(&src->lock)) {
+      spin_unlock(&this->lock);
       continue;
     }
-    if (task[i]->priority < min_p && task[i]->counter > 0) {
-      min_p = task[i]->priority;
-      min = task[i]->counter;
-      next = i;
-    } else if (task[i]->priority == min_p && task[i]->counter < min &&
-               task[i]->counter > 0) {
-      min = task[i]->counter;
-      next = i;
+    struct task_struct *p = pick_migratable_task(src);
+    if (p) {
+      __dequeue_task(src, p);
+      if (p->policy == SCHED_FAIR) {
+        p->vruntime = p->vruntime - src->min_vruntime + this->min_vruntime;
+      }
+      __enqueue_task(this, p);
+    }
+    spin_unlock(&src->lock);
+    spin_unlock(&this->lock);
+    if (p) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// idle 时 S 态中断是关闭的（sstatus.SIE = 0），但 wfi 只要求中断在 sie 中使能，
+// 所以时钟中断和 IPI 仍会把 hart 唤醒，随后由 tick_nohz_idle_exit 处理并清除 STIP。
+// 串口输入在 M 模式处理，同样会唤醒 wfi，等待输入的进程不占用 CPU
+void cpu_idle(void) {
+  struct runqueue *rq = this_rq();
+  while (1) {
+    free_dead_tasks();
+    if (smp_processor_id() == 0 && rq->nr_running == 0 &&
+        nr_live_tasks() == 0) {
+      // 所有进程都已退出
+      sched_show_stat();
     }
+    while (rq->nr_running == 0 && !idle_balance()) {
+      uint64_t start = rdtime();
+      rq->idle_enter++;
+      tick_nohz_idle_enter();
+      wfi();
+      tick_nohz_idle_exit();
+      rq->idle_time += rdtime() - start;
+      ipi_poll();
+      console_wakeup();
+    }
+    schedule(0);
+  }
+}
+
+void sched_show_stat(void) {
+  uint64_t idle_time = 0, idle_enter = 0, nr_switches = 0;
+  int nr_cpus = 0;
+  for_each_online_cpu(c) {
+    idle_time += cpu_rq(c)->idle_time;
+    idle_enter += cpu_rq(c)->idle_enter;
+    nr_switches += cpu_rq(c)->nr_switches;
+    nr_cpus++;
   }
+  printf("[SCHED] uptime %lu ms, %d harts, idle %lu ms (%lu times), %lu switches\n",
+         jiffies * 1000 / HZ, nr_cpus, idle_time / (TIMEBASE_FREQ / 1000),
+         idle_enter, nr_switches);
+}
+
+// 优先级 0 的时间片最长（MAX_TIMESLICE），MAX_PRIO - 1 的最短（MIN_TIMESLICE）
+long task_timeslice(struct task_struct *p) {
+  return MIN_TIMESLICE + (MAX_TIMESLICE - MIN_TIMESLICE) *
+                             (MAX_PRIO - 1 - p->priority) / (MAX_PRIO - 1);
+}
 
-  if (next == NR_TASKS) {
+void do_timer(void) {
+  struct task_struct *curr = current;
+  // idle task 不参与时间片计算
+  if (curr->pid < 0) {
+    return;
+  }
+  if (curr->policy == SCHED_FAIR) {
+    struct runqueue *rq = this_rq();
+    spin_lock(&rq->lock);
+    task_tick_fair(rq, curr);
+    spin_unlock(&rq->lock);
+    return;
+  }
+  if (--curr->counter > 0) {
     return;
   }
+  curr->counter = task_timeslice(curr);
+  need_resched = 1;
+}
+
+void preempt_schedule(void) {
+  // 把 current 放到同优先级队列的末尾，同优先级的其他进程先运行；
+  // 若没有同优先级或更高优先级的进程，schedule 会继续选中 current
+  struct runqueue *rq = this_rq();
+  spin_lock(&rq->lock);
+  if (current->on_rq && current->policy == SCHED_PRIO) {
+    list_move_tail(&current->run_list, &rq->queue[current->priority]);
+  }
+  spin_unlock(&rq->lock);
+  schedule(1);
+}
+
+static struct task_struct *pick_next_task(struct runqueue *rq, bool self) {
+  struct task_struct *p;
+  uint64_t bitmap = rq->bitmap;
+  while (bitmap) {
+    list_for_each_entry(p, &rq->queue[__ffs(bitmap)], run_list) {
+      if (self || p != current) {
+        return p;
+      }
+    }
+    bitmap &= bitmap - 1;
+  }
+  return pick_next_task_fair(rq, self);
+}
 
-  switch_to(task[next]);
+// Select the next task to run from this hart's runqueue: the head of the
+// highest-priority non-empty queue, or the SCHED_FAIR task with the smallest
+// vruntime if all priority queues are empty. If self is false the current
+// task is skipped, so the cost is at most one extra step regardless of the
+// number of tasks.
+void schedule(bool self) {
+  struct cpu *c = this_cpu();
+  struct runqueue *rq = this_rq();
+  struct task_struct *prev = c->curr;
+  struct task_struct *next;
+
+  c->resched = 0;
+  spin_lock(&rq->lock);
+  if (prev->policy == SCHED_FAIR) {
+    update_curr_fair(rq, prev);
+  }
+  // 睡眠或退出的进程在这里离开 runqueue；若在此之前已被唤醒，state 已是 TASK_RUNNING
+  if (prev != c->idle && prev->state != TASK_RUNNING) {
+    __dequeue_task(rq, prev);
+  }
+
+  next = pick_next_task(rq, self);
+  if (next == NULL) {
+    // current 仍可运行则继续运行，否则切换到 idle task
+    if (prev->on_rq || prev == c->idle) {
+      spin_unlock(&rq->lock);
+      return;
+    }
+    next = c->idle;
+  } else if (next->policy == SCHED_FAIR) {
+    set_next_task_fair(rq, next);
+  } else {
+    // 同一优先级的进程轮流运行
+    list_move_tail(&next->run_list, &rq->queue[next->priority]);
+  }
+  // 在 finish_task_switch 之前，其他 hart 不会拉走 next 和 prev
+  next->on_cpu = 1;
+  spin_unlock(&rq->lock);
+  switch_to(next);
 }
 
 void dead_loop() {
@@ -0,0 +1,135 @@
+#include "sched.h"
+#include "riscv.h"
+#include "timer.h"
+
+// 公平调度类（SCHED_FAIR）：
+// 每个进程记录按 nice 加权后的虚拟运行时间 vruntime，runqueue 按 vruntime
+// 组织成红黑树，总是运行 vruntime 最小的进程。与 Linux CFS 不同，正在运行的
+// 进程仍留在树中，更新 vruntime 时先摘下再重新插入。时间单位均为 mtime 计数。
+
+#define MS_TO_MTIME(ms) ((ms) * (TIMEBASE_FREQ / 1000))
+
+uint64_t sched_latency = MS_TO_MTIME(SCHED_LATENCY_MS);
+uint64_t sched_min_granularity = MS_TO_MTIME(SCHED_MIN_GRANULARITY_MS);
+
+// nice -20 .. 19 对应的权重，相邻两级相差约 1.25 倍（与 Linux 相同）
+static const uint64_t prio_to_weight[40] = {
+    88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+    9548,  7620,  6100,  4904,  3906,  3121,  2501,  1991,  1586,  1277,
+    1024,  820,   655,   526,   423,   335,   272,   215,   172,   137,
+    110,   87,    70,    56,    45,    36,    29,    23,    18,    15,
+};
+
+static uint64_t task_weight(struct task_struct *p) {
+  return prio_to_weight[p->nice - MIN_NICE];
+}
+
+static void fair_tree_insert(struct runqueue *rq, struct task_struct *p) {
+  struct rb_node **link = &rq->fair_root.rb_node, *parent = NULL;
+  while (*link) {
+    parent = *link;
+    struct task_struct *entry = rb_entry(parent, struct task_struct, run_node);
+    // vruntime 相同时插到右边，先入队的先运行
+    if ((int64_t)(p->vruntime - entry->vruntime) < 0) {
+      link = &parent->rb_left;
+    } else {
+      link = &parent->rb_right;
+    }
+  }
+  rb_link_node(&p->run_node, parent, link);
+  rb_insert_color(&p->run_node, &rq->fair_root);
+}
+
+static struct task_struct *fair_first(struct runqueue *rq) {
+  struct rb_node *left = rb_first(&rq->fair_root);
+  return left ? rb_entry(left, struct task_struct, run_node) : NULL;
+}
+
+// min_vruntime 单调递增，用作新入队进程 vruntime 的基准
+static void update_min_vruntime(struct runqueue *rq) {
+  struct task_struct *first = fair_first(rq);
+  if (first && (int64_t)(first->vruntime - rq->min_vruntime) > 0) {
+    rq->min_vruntime = first->vruntime;
+  }
+}
+
+// 本轮调度周期内 p 应得的运行时间
+static uint64_t sched_slice(struct runqueue *rq, struct task_struct *p) {
+  uint64_t period = sched_latency;
+  if (rq->nr_fair * sched_min_granularity > period) {
+    period = rq->nr_fair * sched_min_granularity;
+  }
+  uint64_t slice = period * task_weight(p) / rq->fair_load;
+  return slice > sched_min_granularity ? slice : sched_min_granularity;
+}
+
+void enqueue_task_fair(struct runqueue *rq, struct task_struct *p) {
+  // 睡眠很久的进程最多获得半个调度周期的补偿，避免长时间独占 CPU
+  uint64_t vruntime = rq->min_vruntime - sched_latency / 2;
+  if (rq->min_vruntime > sched_latency / 2 &&
+      (int64_t)(p->vruntime - vruntime) < 0) {
+    p->vruntime = vruntime;
+  }
+  fair_tree_insert(rq, p);
+  rq->nr_fair++;
+  rq->fair_load += task_weight(p);
+}
+
+void dequeue_task_fair(struct runqueue *rq, struct task_struct *p) {
+  rb_erase(&p->run_node, &rq->fair_root);
+  rq->nr_fair--;
+  rq->fair_load -= task_weight(p);
+  update_min_vruntime(rq);
+}
+
+void update_curr_fair(struct runqueue *rq, struct task_struct *p) {
+  uint64_t now = rdtime();
+  uint64_t delta = now - p->exec_start;
+  p->exec_start = now;
+  p->sum_exec_runtime += delta;
+
+  if (!p->on_rq) {
+    p->vruntime += delta * NICE_0_LOAD / task_weight(p);
+    return;
+  }
+  rb_erase(&p->run_node, &rq->fair_root);
+  p->vruntime += delta * NICE_0_LOAD / task_weight(p);
+  fair_tree_insert(rq, p);
+  update_min_vruntime(rq);
+}
+
+void set_next_task_fair(struct runqueue *rq, struct task_struct *p) {
+  p->exec_start = rdtime();
+  p->prev_sum_exec_runtime = p->sum_exec_runtime;
+}
+
+struct task_struct *pick_next_task_fair(struct runqueue *rq, bool self) {
+  struct task_struct *first = fair_first(rq);
+  if (first && first == current && !self) {
+    struct rb_node *next = rb_next(&first->run_node);
+    first = next ? rb_entry(next, struct task_struct, run_node) : NULL;
+  }
+  return first;
+}
+
+void task_tick_fair(struct runqueue *rq, struct task_struct *curr) {
+  update_curr_fair(rq, curr);
+  if (rq->nr_fair <= 1) {
+    return;
+  }
+
+  uint64_t ideal = sched_slice(rq, curr);
+  uint64_t delta_exec = curr->sum_exec_runtime - curr->prev_sum_exec_runtime;
+  if (delta_exec > ideal) {
+    need_resched = 1;
+    return;
+  }
+  // 至少运行 sched_min_granularity，避免切换过于频繁
+  if (delta_exec < sched_min_granularity) {
+    return;
+  }
+  struct task_struct *first = fair_first(rq);
+  if ((int64_t)(curr->vruntime - first->vruntime) > (int64_t)ideal) {
+    need_resched = 1;
+  }
+}
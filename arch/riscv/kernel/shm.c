@@ -0,0 +1,303 @@
+#include "shm.h"
+#include "fs.h"
+#include "mm.h"
+#include "pipe.h"
+#include "sched.h"
+#include "slub.h"
+#include "spinlock.h"
+#include "task_manager.h"
+#include "tlb.h"
+#include "vm.h"
+
+int strcmp(const char *a, const char *b);
+
+// 保护 shm_list 以及所有对象的 npages、pages、refs、linked
+static struct spinlock shm_lock = SPINLOCK_INIT;
+static LIST_HEAD(shm_list);
+
+static struct shm_object *alloc_shm(void) {
+  struct shm_object *shm = kmalloc(sizeof(struct shm_object));
+  if (shm) {
+    memset(shm, 0, sizeof(struct shm_object));
+    INIT_LIST_HEAD(&shm->list);
+  }
+  return shm;
+}
+
+// 调用时持有 shm_lock，引用减到 0 且已经没有名字时返回 true，由调用者在锁外销毁
+static bool shm_put_locked(struct shm_object *shm) {
+  return --shm->refs == 0 && !shm->linked;
+}
+
+static void free_shm(struct shm_object *shm) {
+  for (uint64_t i = 0; i < shm->npages; i++) {
+    if (shm->pages[i]) {
+      put_page(shm->pages[i]);
+    }
+  }
+  if (shm->pages) {
+    kfree(shm->pages);
+  }
+  kfree(shm);
+}
+
+void shm_put(struct shm_object *shm) {
+  spin_lock(&shm_lock);
+  bool last = shm_put_locked(shm);
+  spin_unlock(&shm_lock);
+  if (last) {
+    free_shm(shm);
+  }
+}
+
+// 逐字节拷贝用户传入的名字，跨页时先处理缺页
+static int copy_shm_name(char *dst, const char *src) {
+  for (int i = 0; i < SHM_NAME_MAX; i++) {
+    uint64_t va = (uint64_t)(src + i);
+    if ((i == 0 || va % PAGE_SIZE == 0) && fault_in_user(va, 1, 0)) {
+      return -1;
+    }
+    dst[i] = src[i];
+    if (dst[i] == '\0') {
+      return i ? 0 : -1;
+    }
+  }
+  return -1;
+}
+
+static struct shm_object *find_shm(const char *name) {
+  struct shm_object *shm;
+  list_for_each_entry(shm, &shm_list, list) {
+    if (strcmp(shm->name, name) == 0) {
+      return shm;
+    }
+  }
+  return NULL;
+}
+
+long shm_open(const char *name, int flags) {
+  char buf[SHM_NAME_MAX];
+  if (copy_shm_name(buf, name)) {
+    return -1;
+  }
+  struct file *f = kmalloc(sizeof(struct file));
+  struct shm_object *new = (flags & O_CREAT) ? alloc_shm() : NULL;
+  if (f == NULL || ((flags & O_CREAT) && new == NULL)) {
+    if (f) kfree(f);
+    if (new) kfree(new);
+    return -1;
+  }
+
+  spin_lock(&shm_lock);
+  struct shm_object *shm = find_shm(buf);
+  if (shm ? (flags & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL) : !(flags & O_CREAT)) {
+    spin_unlock(&shm_lock);
+    kfree(f);
+    if (new) kfree(new);
+    return -1;
+  }
+  if (shm == NULL) {
+    shm = new;
+    new = NULL;
+    memcpy(shm->name, buf, SHM_NAME_MAX);
+    shm->linked = 1;
+    list_add(&shm->list, &shm_list);
+  }
+  shm->refs++;
+  spin_unlock(&shm_lock);
+  if (new) {
+    kfree(new);
+  }
+
+  memset(f, 0, sizeof(struct file));
+  f->type = FILE_SHM;
+  f->shm = shm;
+  f->refs = 1;
+  f->flags = SFS_FLAG_READ | ((flags & O_RDWR) ? SFS_FLAG_WRITE : 0);
+  int fd = fd_install(current->fs, 2, f);
+  if (fd < 0) {
+    shm_close(f);
+  }
+  return fd;
+}
+
+long shm_unlink(const char *name) {
+  char buf[SHM_NAME_MAX];
+  if (copy_shm_name(buf, name)) {
+    return -1;
+  }
+  spin_lock(&shm_lock);
+  struct shm_object *shm = find_shm(buf);
+  if (shm == NULL) {
+    spin_unlock(&shm_lock);
+    return -1;
+  }
+  list_del(&shm->list);
+  shm->linked = 0;
+  bool last = shm->refs == 0;
+  spin_unlock(&shm_lock);
+  if (last) {
+    free_shm(shm);
+  }
+  return 0;
+}
+
+struct file *fget_shm(int fd) {
+  return fget(current->fs, fd, FILE_SHM);
+}
+
+// 把对象的大小改为 len 字节，新的页表在锁外分配，只记录物理地址，页本身等到缺页时才分配
+static long shm_resize(struct shm_object *shm, uint64_t len) {
+  uint64_t npages = ROUNDUP(len, PAGE_SIZE) / PAGE_SIZE;
+  if (npages > MEMORY_SIZE / PAGE_SIZE) {
+    return -1;
+  }
+  uint64_t *pages = npages ? kmalloc(npages * sizeof(uint64_t)) : NULL;
+  if (npages && pages == NULL) {
+    return -1;
+  }
+
+  spin_lock(&shm_lock);
+  uint64_t *old = shm->pages;
+  uint64_t keep = min(npages, shm->npages);
+  for (uint64_t i = 0; i < npages; i++) {
+    pages[i] = i < keep ? old[i] : 0;
+  }
+  // 截掉的页在仍映射着它的地址空间中保持有效，直到被解除映射
+  for (uint64_t i = keep; i < shm->npages; i++) {
+    if (old[i]) {
+      put_page(old[i]);
+    }
+  }
+  shm->pages = pages;
+  shm->npages = npages;
+  spin_unlock(&shm_lock);
+
+  if (old) {
+    kfree(old);
+  }
+  return 0;
+}
+
+long shm_truncate(struct file *f, uint64_t len) {
+  if (!(f->flags & SFS_FLAG_WRITE)) {
+    return -1;
+  }
+  return shm_resize(f->shm, len);
+}
+
+void shm_close(struct file *f) {
+  shm_put(f->shm);
+  kfree(f);
+}
+
+void exit_shm(struct files_struct *files) {
+  for (int fd = 0; fd < 16; fd++) {
+    struct file *f = files->fds[fd];
+    if (f && f->type == FILE_SHM) {
+      files->fds[fd] = NULL;
+      fput(f);
+    }
+  }
+}
+
+int shm_mmap(struct vm_area_struct *vma, struct file *f, uint64_t offset) {
+  if (f == NULL) {
+    // 匿名共享映射：大小就是映射的长度，只能通过 fork 共享
+    struct shm_object *shm = alloc_shm();
+    if (shm == NULL) {
+      return -1;
+    }
+    if (shm_resize(shm, vma->vm_end - vma->vm_start)) {
+      kfree(shm);
+      return -1;
+    }
+    shm->refs = 1;
+    vma->vm_shm = shm;
+    vma->vm_pgoff = 0;
+    return 0;
+  }
+
+  if (offset % PAGE_SIZE || ((vma->vm_flags & PTE_W) && !(f->flags & SFS_FLAG_WRITE))) {
+    return -1;
+  }
+  spin_lock(&shm_lock);
+  f->shm->refs++;
+  spin_unlock(&shm_lock);
+  vma->vm_shm = f->shm;
+  vma->vm_pgoff = offset / PAGE_SIZE;
+  return 0;
+}
+
+int shm_fault(uint64_t *pgtbl, struct vm_area_struct *vma, uint64_t addr) {
+  struct shm_object *shm = vma->vm_shm;
+  uint64_t va = ROUNDDOWN(addr, PAGE_SIZE);
+  uint64_t index = vma->vm_pgoff + (va - vma->vm_start) / PAGE_SIZE;
+  if (get_pte(pgtbl, va) & PTE_V) {
+    return 0;
+  }
+
+  spin_lock(&shm_lock);
+  if (index >= shm->npages) {
+    spin_unlock(&shm_lock);
+    return -1;
+  }
+  uint64_t pa = shm->pages[index];
+  if (pa == 0) {
+    pa = alloc_page();
+    if (pa == 0) {
+      spin_unlock(&shm_lock);
+      return -1;
+    }
+    memset((void *)pa, 0, PAGE_SIZE);
+    get_page(pa);
+    shm->pages[index] = pa;
+  }
+  // 这一个引用属于 PTE，在 shm_zap 中归还
+  get_page(pa);
+  spin_unlock(&shm_lock);
+
+  create_mapping(pgtbl, va, pa, PAGE_SIZE, vma->vm_flags);
+  vma->mapped = 1;
+  return 0;
+}
+
+int shm_populate(uint64_t *pgtbl, struct vm_area_struct *vma) {
+  for (uint64_t va = vma->vm_start; va < vma->vm_end; va += PAGE_SIZE) {
+    if (shm_fault(pgtbl, vma, va)) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void shm_zap(struct mm_struct *mm, uint64_t *pgtbl, struct vm_area_struct *vma) {
+  if (!vma->mapped) {
+    return;
+  }
+  for (uint64_t va = vma->vm_start; va < vma->vm_end; va += PAGE_SIZE) {
+    uint64_t pte = get_pte(pgtbl, va);
+    if (pte & PTE_V) {
+      // 这可能是最后一个引用，先刷掉 TLB 中的旧映射再归还
+      create_mapping(pgtbl, va, 0, PAGE_SIZE, 0);
+      flush_tlb_page(mm, va);
+      put_page((pte >> 10) << 12);
+    }
+  }
+  vma->mapped = 0;
+}
+
+int shm_copy(uint64_t *dst_pgtbl, uint64_t *src_pgtbl,
+             struct vm_area_struct *dst, struct vm_area_struct *src) {
+  spin_lock(&shm_lock);
+  src->vm_shm->refs++;
+  spin_unlock(&shm_lock);
+  for (uint64_t va = src->vm_start; va < src->vm_end; va += PAGE_SIZE) {
+    uint64_t pte = get_pte(src_pgtbl, va);
+    if (pte & PTE_V) {
+      get_page((pte >> 10) << 12);
+      create_mapping(dst_pgtbl, va, (pte >> 10) << 12, PAGE_SIZE, src->vm_flags);
+    }
+  }
+  return 0;
+}
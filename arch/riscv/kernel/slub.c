@@ -1,6 +1,7 @@
 #include "slub.h"
 
 #include "mm.h"
+#include "spinlock.h"
 #include "stddef.h"
 
 enum { PAGE_FREE, PAGE_BUDDY, PAGE_SLUB, PAGE_RESERVE };
@@ -9,6 +10,9 @@ struct cache_area cache_region;
 unsigned long cache_tid = 0;
 
 struct kmem_cache *slub_allocator[NR_PARTIAL] = {};
+
+// 保护所有 kmem_cache、页属性和 cache_region
+static struct spinlock slub_lock = SPINLOCK_INIT;
 void *page_base;
 
 const size_t kmem_cache_objsize[] = {8, 16, 32, 64, 128, 256, 512, 1024, 2048};
@@ -225,20 +229,25 @@ struct kmem_cache *kmem_cache_create(const char *name, size_t size,
   struct kmem_cache *s = NULL;
   const char *cache_name;
 
+  spin_lock(&slub_lock);
   s = cache_create(name, size, aligns, flags, func);
   if (cache_alloc_pages(s) == NULL) {
     free_slub_structure(s);
-    return NULL;
-  } else {
-    return s;
+    s = NULL;
   }
+  spin_unlock(&slub_lock);
+  return s;
 }
 
 int kmem_cache_destroy(struct kmem_cache *s) {
   struct list_head *l;
   struct page *p;
+  spin_lock(&slub_lock);
   list_for_each(l, &(s->list)) {
-    if (list_entry(l, struct page, slub_list)->count != 0) return -1;
+    if (list_entry(l, struct page, slub_list)->count != 0) {
+      spin_unlock(&slub_lock);
+      return -1;
+    }
   }
   list_for_each(l, &(s->list)) {
     p = list_entry(l, struct page, slub_list);
@@ -246,6 +255,7 @@ int kmem_cache_destroy(struct kmem_cache *s) {
     clear_page_attr(p);
   }
   free_slub_structure(s);
+  spin_unlock(&slub_lock);
   return 0;
 }
 
@@ -253,6 +263,7 @@ void *kmem_cache_alloc(struct kmem_cache *cache) {
   void *object = NULL;
   struct list_head *l;
   struct page *p;
+  spin_lock(&slub_lock);
   if (cache->freelist == NULL) {
     list_for_each(l, &(cache->list)) {
       p = list_entry(l, struct page, slub_list);
@@ -260,12 +271,15 @@ void *kmem_cache_alloc(struct kmem_cache *cache) {
         cache->freelist = p->freelist;
       }
     }
-    if (cache->freelist == NULL && cache_alloc_pages(cache) == NULL)
+    if (cache->freelist == NULL && cache_alloc_pages(cache) == NULL) {
+      spin_unlock(&slub_lock);
       return NULL;
+    }
   }
   object = cache->freelist;
   cache->freelist = *(cache->freelist);
   (ADDR_TO_PAGE(object)->header)->count++;
+  spin_unlock(&slub_lock);
   if (cache->init_func != NULL)
     cache->init_func(object);
   else {
@@ -275,10 +289,12 @@ void *kmem_cache_alloc(struct kmem_cache *cache) {
 }
 
 void kmem_cache_free(void *obj) {
-  struct page *page = ADDR_TO_PAGE(obj)->header;
+  struct page *page;
   struct kmem_cache *s;
   void *p;
 
+  spin_lock(&slub_lock);
+  page = ADDR_TO_PAGE(obj)->header;
   s = page->slub;
   if (page->freelist == NULL) {
     page->freelist = obj;
@@ -293,6 +309,7 @@ void kmem_cache_free(void *obj) {
     clear_page_attr(page);
     s->nr_partial--;
   }
+  spin_unlock(&slub_lock);
 
   return;
 }
@@ -322,7 +339,9 @@ void *kmalloc(size_t size) {
     // TODO:
     p = alloc_pages((size - 1) / PAGE_SIZE + 1);
 
+    spin_lock(&slub_lock);
     set_page_attr(p, (size - 1) / PAGE_SIZE, PAGE_BUDDY);
+    spin_unlock(&slub_lock);
   }
 
   return p;
@@ -334,6 +353,7 @@ void kfree(const void *addr) {
   if (addr == NULL) return;
 
   // 获得地址所在页的属性
+  spin_lock(&slub_lock);
   page = ADDR_TO_PAGE(addr);
 
   // TODO: 判断当前页面属性，使用 free_pages 接口回收或使用 kmem_cache_free 接口回收
@@ -343,10 +363,14 @@ void kfree(const void *addr) {
     free_pages((uint64_t)addr);
 
     clear_page_attr(ADDR_TO_PAGE(addr)->header);
+    spin_unlock(&slub_lock);
 
   } else if (page->flags == PAGE_SLUB) {
+    spin_unlock(&slub_lock);
     // TODO:
     kmem_cache_free((void *)addr);
+  } else {
+    spin_unlock(&slub_lock);
   }
 
   return;
@@ -0,0 +1,55 @@
+#include "smp.h"
+#include "riscv.h"
+#include "sbi.h"
+#include "sched.h"
+#include "stdio.h"
+#include "timer.h"
+#include "tlb.h"
+
+struct cpu cpus[NR_CPUS];
+
+uint64_t cpu_online_mask;
+
+// 其他 hart 在 head.S 中自旋等待该标志，见 _secondary_supervisor
+extern volatile uint64_t smp_boot_flag;
+
+void cpu_init(uint64_t hartid) {
+  struct cpu *c = &cpus[hartid];
+  c->id = hartid;
+  asm volatile("mv tp, %0" : : "r"(c));
+}
+
+void smp_boot_secondaries(void) {
+  __atomic_store_n(&smp_boot_flag, 1, __ATOMIC_RELEASE);
+}
+
+void secondary_start_kernel(uint64_t hartid) {
+  cpu_init(hartid);
+  init_idle();
+  timer_init();
+  __atomic_fetch_or(&cpu_online_mask, 1UL << hartid, __ATOMIC_RELEASE);
+  printf("[SMP] hart %d online\n", hartid);
+  cpu_idle();
+}
+
+void send_ipi(uint64_t mask, uint64_t ipi) {
+  for_each_online_cpu(c) {
+    if (mask & (1UL << c)) {
+      __atomic_fetch_or(&cpus[c].ipi_pending, ipi, __ATOMIC_RELEASE);
+    }
+  }
+  sbi_send_ipi(mask);
+}
+
+void handle_ipi(void) {
+  struct cpu *c = this_cpu();
+  clear_csr(sip, SIP_SSIP);
+
+  uint64_t pending = __atomic_exchange_n(&c->ipi_pending, 0, __ATOMIC_ACQ_REL);
+  if (pending & IPI_TLB_FLUSH) {
+    tlb_flush_ipi();
+  }
+  if (pending & IPI_RESCHEDULE) {
+    c->resched = 1;
+  }
+}
@@ -1,20 +1,30 @@
 #include "syscall.h"
+#include "console.h"
 #include "fs.h"
+#include "futex.h"
 #include "list.h"
 #include "riscv.h"
 #include "sched.h"
 #include "task_manager.h"
 #include "stdio.h"
 #include "defs.h"
+#include "exec.h"
 #include "slub.h"
 #include "mm.h"
 #include "vm.h"
+#include "tlb.h"
+#include "filemap.h"
+#include "fpu.h"
+#include "io_uring.h"
+#include "pid.h"
+#include "pipe.h"
+#include "shm.h"
+#include "vdso.h"
 
 extern uint64_t text_start;
 extern uint64_t rodata_start;
 extern uint64_t data_start;
-extern uint64_t user_program_start;
-extern void trap_s_bottom(void);
+extern void ret_from_fork(void);
 
 int strcmp(const char *a, const char *b) {
   while (*a && *b) {
@@ -32,17 +42,550 @@ int strcmp(const char *a, const char *b) {
   return 0;
 }
 
-uint64_t get_program_address(const char * name) {
-    uint64_t offset = 0;
-    if (strcmp(name, "hello") == 0) offset = PAGE_SIZE * 2;
-    else if (strcmp(name, "read") == 0) offset = PAGE_SIZE * 4;
-    else if (strcmp(name, "test") == 0) offset = PAGE_SIZE * 6;
-    else if (strcmp(name, "fssh") == 0) offset = PAGE_SIZE * 7;
-    else {
-        printf("Unknown user program %s\n", name);
-        while (1);
-    }
-    return PHYSICAL_ADDR((uint64_t)(&user_program_start) + offset);
+// ---------------------------------------------------------------------------
+// 快速路径：trap_s 只保存调用者保存的寄存器，直接按 a7 查 sys_call_table 调用，
+// 返回值写回 a0。s0 ~ s11 由 C 函数自己保存，不用放进栈帧。
+// 表中没有的系统调用（fork 需要完整的寄存器复制给子进程，exec、exit 不返回）
+// 走 handler_s -> syscall() 的慢速路径，栈帧是完整的。
+
+static long sys_getpid(void) {
+    return getpid();
+}
+
+static long sys_gettid(void) {
+    return current->pid;
+}
+
+static long sys_futex(uint32_t *uaddr, int op, uint32_t val) {
+    if (op == FUTEX_WAIT) {
+        return futex_wait(uaddr, val);
+    }
+    if (op == FUTEX_WAKE) {
+        return futex_wake(uaddr, val);
+    }
+    return -1;
+}
+
+// fd 0、1 是控制台，除非用 dup2 换成了管道
+static long sys_read(int fd, char *buf, uint64_t count) {
+    struct file *f = fget_pipe(fd);
+    if (f) {
+        long ret = pipe_read(f, buf, count);
+        fput(f);
+        return ret;
+    }
+    if (fd != 0 || fault_in_user((uint64_t)buf, count, 1)) {
+        return -1;
+    }
+    return console_read(buf, count);
+}
+
+static long sys_write(int fd, const char *buffer, int size) {
+    struct file *f = fget_pipe(fd);
+    if (f) {
+        long ret = pipe_write(f, buffer, size);
+        fput(f);
+        return ret;
+    }
+    if (fd == 1 && size > 0) {
+        if (fault_in_user((uint64_t)buffer, size, 0)) {
+            return -1;
+        }
+        // 只拷贝进输出环，由 UART 中断慢慢发送
+        console_write(buffer, size);
+    }
+    return size;
+}
+
+static long sys_pipe(int *fds) {
+    return do_pipe(fds);
+}
+
+static long sys_dup2(int oldfd, int newfd) {
+    return do_dup2(oldfd, newfd);
+}
+
+static long sys_vmsplice(int fd, uint64_t addr, uint64_t len) {
+    struct file *f = fget_pipe(fd);
+    if (f == NULL) {
+        return -1;
+    }
+    long ret = pipe_vmsplice(f, addr, len);
+    fput(f);
+    return ret;
+}
+
+static long sys_ftruncate(int fd, uint64_t length) {
+    // SFS 不支持截断，只有共享内存对象可以设置大小
+    struct file *f = fget_shm(fd);
+    if (f == NULL) {
+        return -1;
+    }
+    long ret = shm_truncate(f, length);
+    fput(f);
+    return ret;
+}
+
+static long sys_shm_open(const char *name, int flags) {
+    return shm_open(name, flags);
+}
+
+static long sys_shm_unlink(const char *name) {
+    return shm_unlink(name);
+}
+
+static long sys_wait(long pid, int *status) {
+    // 1. find the child whose pid == arg0 (or any child if arg0 == -1)
+    // 2. if it is a zombie, store its exit code to *arg1 and reap it
+    // 3. otherwise sleep until a child exits, then goto 1.
+    return do_wait(pid, status);
+}
+
+static long sys_nanosleep(const struct timespec *req, struct timespec *rem) {
+    // 没有信号，睡眠不会被打断，所以不写回 rem
+    struct timespec ts;
+    if (fault_in_user((uint64_t)req, sizeof(struct timespec), 0)) {
+        return -1;
+    }
+    ts = *req;
+    if (ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= NSEC_PER_SEC) {
+        return -1;
+    }
+    // tv_sec 太大时乘法或加法会溢出成一个过去的时刻，改为一个远在将来的时刻。
+    // 不用 UINT64_MAX：时间轮把到期时间向上取整到刻度时还要再加一点
+    uint64_t now = rdtime();
+    uint64_t deadline = UINT64_MAX >> 1;
+    if (now < deadline && (uint64_t)ts.tv_sec < (deadline - now) / TIMEBASE_FREQ - 1) {
+        deadline = now + ts.tv_sec * TIMEBASE_FREQ + NS_TO_CYCLES(ts.tv_nsec);
+    }
+    schedule_timeout(deadline);
+    return 0;
+}
+
+static long sys_mmap(uint64_t addr, uint64_t len, uint64_t prot,
+                     uint64_t flags, uint64_t fd, uint64_t offset) {
+    // 映射只能放在 [USER_HEAP_START, USER_MMAP_END) 中，MAP_POPULATE 会立即建立映射。
+    // prot 是用户页的页表项权限，VM_* 是内核内部的标志，用户不能传入
+    if (addr % PAGE_SIZE || len == 0 || len % PAGE_SIZE || addr < USER_HEAP_START ||
+        addr > USER_MMAP_END || len > USER_MMAP_END - addr ||
+        (prot & ~(PTE_V | PTE_R | PTE_W | PTE_X | PTE_U)) ||
+        (prot & (PTE_V | PTE_U)) != (PTE_V | PTE_U) ||
+        (flags & (VM_PAGED | VM_URING))) {
+        return -1;
+    }
+    struct vm_area_struct* vma = (struct vm_area_struct*)kmalloc(sizeof(struct vm_area_struct));
+    if (vma == NULL) {
+        return -1;
+    }
+    vma->vm_start = addr;
+    vma->vm_end = addr + len;
+    vma->vm_flags = prot;
+    vma->mapped = 0;
+    vma->vm_mmap_flags = flags;
+    vma->vm_ino = 0;
+    vma->vm_pgoff = 0;
+    vma->vm_pages = NULL;
+    vma->vm_shm = NULL;
+
+    // 共享内存：匿名的 MAP_SHARED，或以 MAP_SHARED 映射 shm_open 得到的 fd
+    struct file *shm = (flags & MAP_ANONYMOUS) ? NULL : fget_shm(fd);
+    if ((flags & MAP_SHARED) && ((flags & MAP_ANONYMOUS) || shm)) {
+        // shm_mmap 让 VMA 持有共享内存对象，映射建立后 fd 就可以关闭了
+        int err = shm_mmap(vma, shm, offset);
+        if (shm) {
+            fput(shm);
+        }
+        if (err) {
+            kfree(vma);
+            return -1;
+        }
+    } else if (!(flags & MAP_ANONYMOUS) && (flags & (MAP_SHARED | MAP_PRIVATE))) {
+        // 文件映射：fd 为打开的 SFS 文件，offset 为文件内偏移（需按页对齐）。
+        // SFS 文件只在 fs_lock 中关闭，持有 files->lock 时它不会被释放
+        struct files_struct *files = current->fs;
+        struct file *f = NULL;
+        if (shm) {
+            fput(shm);
+        } else if (fd < 16) {
+            spin_lock(&files->lock);
+            f = files->fds[fd];
+            // 映射的权限不能超过打开方式：共享的可写映射会写回文件，私有映射的写不会
+            if (f && f->type == FILE_SFS &&
+                (!(prot & PTE_R) || (f->flags & SFS_FLAG_READ)) &&
+                (!(flags & MAP_SHARED) || !(prot & PTE_W) || (f->flags & SFS_FLAG_WRITE))) {
+                vma->vm_ino = f->inode_no;
+            } else {
+                f = NULL;
+            }
+            spin_unlock(&files->lock);
+        }
+        if (f == NULL || offset % PAGE_SIZE) {
+            kfree(vma);
+            return -1;
+        }
+        vma->vm_pgoff = offset / PAGE_SIZE;
+        vma->vm_pages = kmalloc(vma_pages(vma) * sizeof(Mblock));
+        if (vma->vm_pages == NULL) {
+            kfree(vma);
+            return -1;
+        }
+        memset(vma->vm_pages, 0, vma_pages(vma) * sizeof(Mblock));
+    }
+    spin_lock(&current->mm->lock);
+    // VMA 之间不能重叠，find_vma 和 VMA 树都依赖这一点
+    struct vm_area_struct *next = find_vma_next(current->mm, addr);
+    if (next && next != current->mm->vm && next->vm_start < addr + len) {
+        spin_unlock(&current->mm->lock);
+        if (vma->vm_pages) {
+            kfree(vma->vm_pages);
+        }
+        if (vma->vm_shm) {
+            shm_put(vma->vm_shm);
+        }
+        kfree(vma);
+        return -1;
+    }
+    insert_vma(current->mm, vma);
+
+    // MAP_POPULATE: 预先建立映射，之后访问不再触发缺页
+    if ((flags & MAP_POPULATE) &&
+        populate_vma(current_pgtbl(), vma)) {
+        destroy_vma(current->mm, current_pgtbl(), vma);
+        spin_unlock(&current->mm->lock);
+        return -1;
+    }
+    spin_unlock(&current->mm->lock);
+    return addr;
+}
+
+static long sys_munmap(uint64_t addr, uint64_t len) {
+    long ret = -1;
+    spin_lock(&current->mm->lock);
+    struct vm_area_struct* vma = find_vma(current->mm, addr);
+    if (vma && vma->vm_start == addr && vma->vm_end == addr + len) {
+        destroy_vma(current->mm, current_pgtbl(), vma);
+        ret = 0;
+    }
+    spin_unlock(&current->mm->lock);
+    return ret;
+}
+
+static long sys_brk(uint64_t addr) {
+    spin_lock(&current->mm->lock);
+    long ret = do_brk(current->mm, current_pgtbl(), addr);
+    spin_unlock(&current->mm->lock);
+    return ret;
+}
+
+static long sys_madvise(uint64_t addr, uint64_t len, int advice) {
+    // 只支持这两种，其他的不能当作成功静默忽略
+    if (advice != MADV_WILLNEED && advice != MADV_DONTNEED) {
+        return -1;
+    }
+    // 以 VMA 为粒度处理所有与 [addr, addr + len) 相交的区域
+    uint64_t *pgtbl = current_pgtbl();
+    long ret = 0;
+    spin_lock(&current->mm->lock);
+    struct vm_area_struct* vma = find_vma_next(current->mm, addr);
+    while (vma && vma != current->mm->vm && vma->vm_start < addr + len) {
+        if (advice == MADV_WILLNEED) {
+            if (populate_vma(pgtbl, vma)) {
+                ret = -1;
+                break;
+            }
+        } else if (advice == MADV_DONTNEED && !(vma->vm_mmap_flags & VM_URING)) {
+            // 环的页属于 io_uring，丢弃它等于销毁环
+            zap_vma(current->mm, pgtbl, vma);
+        }
+        vma = list_entry(vma->vm_list.next, struct vm_area_struct, vm_list);
+    }
+    spin_unlock(&current->mm->lock);
+    return ret;
+}
+
+static long sys_sched_setscheduler(long pid, int policy, long param) {
+    long ret = -1;
+    spin_lock(&tasklist_lock);
+    struct task_struct *p = find_task_by_pid(pid);
+    if (p && p->state != TASK_DEAD && p->state != TASK_ZOMBIE) {
+        ret = sched_setscheduler(p, policy, param);
+    }
+    spin_unlock(&tasklist_lock);
+    return ret;
+}
+
+static long sys_io_uring_setup(uint64_t addr, uint32_t entries, uint32_t flags) {
+    return io_uring_setup(addr, entries, flags);
+}
+
+static long sys_io_uring_enter(uint32_t to_submit) {
+    return io_uring_enter(to_submit);
+}
+
+static long sys_sfs_open(const char *path, uint32_t flags) {
+    char buf[SFS_PATH_MAX];
+    if (copy_str_from_user(buf, path, SFS_PATH_MAX)) {
+        return -1;
+    }
+    spin_lock(&fs_lock);
+    long ret = sfs_open(buf, flags);
+    spin_unlock(&fs_lock);
+    return ret;
+}
+
+// 管道也占用 fds[]，SFS 的 close、read、write 对管道 fd 同样有效；
+// 共享内存 fd 只能 close，数据通过 mmap 访问
+
+static long sys_sfs_close(int fd) {
+    // 其他线程可能还在读写这个管道或映射这个对象，由最后一个引用关闭
+    struct file *f = fd_remove(current->fs, fd, FILE_PIPE);
+    if (f) {
+        fput(f);
+        return 0;
+    }
+    f = fd_remove(current->fs, fd, FILE_SHM);
+    if (f) {
+        fput(f);
+        return 0;
+    }
+    spin_lock(&fs_lock);
+    long ret = sfs_close(fd);
+    spin_unlock(&fs_lock);
+    return ret;
+}
+
+// SFS 文件只在 fs_lock 中装入和关闭，dup2 也不会替换它，
+// 所以在 fs_lock 中检查过 fd 是 SFS 文件之后它不会变成别的
+static long sys_sfs_seek(int fd, int32_t off, int fromwhere) {
+    spin_lock(&fs_lock);
+    if (fd_type(current->fs, fd) != FILE_SFS) {
+        spin_unlock(&fs_lock);
+        return -1;
+    }
+    long ret = sfs_seek(fd, off, fromwhere);
+    spin_unlock(&fs_lock);
+    return ret;
+}
+
+static long sys_sfs_read(int fd, char *buf, uint32_t len) {
+    struct file *f = fget_pipe(fd);
+    if (f) {
+        long ret = pipe_read(f, buf, len);
+        fput(f);
+        return ret;
+    }
+    if (fault_in_user((uint64_t)buf, len, 1)) {
+        return -1;
+    }
+    spin_lock(&fs_lock);
+    if (fd_type(current->fs, fd) != FILE_SFS) {
+        spin_unlock(&fs_lock);
+        return -1;
+    }
+    long ret = sfs_read(fd, buf, len);
+    spin_unlock(&fs_lock);
+    return ret;
+}
+
+static long sys_sfs_write(int fd, char *buf, uint32_t len) {
+    struct file *f = fget_pipe(fd);
+    if (f) {
+        long ret = pipe_write(f, buf, len);
+        fput(f);
+        return ret;
+    }
+    if (fault_in_user((uint64_t)buf, len, 0)) {
+        return -1;
+    }
+    spin_lock(&fs_lock);
+    if (fd_type(current->fs, fd) != FILE_SFS) {
+        spin_unlock(&fs_lock);
+        return -1;
+    }
+    long ret = sfs_write(fd, buf, len);
+    spin_unlock(&fs_lock);
+    return ret;
+}
+
+// files[i] 是用户的缓冲区，每个 SFS_MAX_FILENAME_LEN + 1 字节。
+// 文件名先取到内核缓冲区里，放开 fs_lock 之后再拷贝给用户：处理缺页要拿 mm->lock，不能在 fs_lock 里面
+static long sys_sfs_get_files(const char *path, char **files) {
+    const int len = SFS_MAX_FILENAME_LEN + 1;
+    char buf[SFS_PATH_MAX];
+    if (copy_str_from_user(buf, path, SFS_PATH_MAX)) {
+        return -1;
+    }
+    spin_lock(&fs_lock);
+    long n = sfs_get_files(buf, NULL);
+    char *names = n > 0 ? kmalloc(n * len) : NULL;
+    char **knames = n > 0 ? kmalloc(n * sizeof(char *)) : NULL;
+    if (names && knames) {
+        memset(names, 0, n * len);
+        for (long i = 0; i < n; i++) {
+            knames[i] = names + i * len;
+        }
+        sfs_get_files(buf, knames);
+    }
+    spin_unlock(&fs_lock);
+
+    if (n > 0 && (names == NULL || knames == NULL ||
+                  fault_in_user((uint64_t)files, n * sizeof(char *), 0))) {
+        n = -1;
+    }
+    for (long i = 0; i < n; i++) {
+        if (fault_in_user((uint64_t)files[i], len, 1)) {
+            n = -1;
+            break;
+        }
+        memcpy(files[i], knames[i], len);
+    }
+    if (names) kfree(names);
+    if (knames) kfree(knames);
+    return n;
+}
+
+// 各系统调用只声明自己用到的参数。表中的函数必须都是 syscall_fn_t 原型，
+// 通过不兼容的函数指针调用是未定义行为，所以由 SYSCALL_WRAP 生成统一原型的包装函数，
+// 在包装函数里把 a0 ~ a5 转换成各系统调用自己的参数类型
+#define SYSCALL_WRAP(name, ...)                                         \
+    static long __##name(uint64_t a0, uint64_t a1, uint64_t a2,         \
+                         uint64_t a3, uint64_t a4, uint64_t a5) {       \
+        return name(__VA_ARGS__);                                       \
+    }
+
+SYSCALL_WRAP(sys_read, a0, (char *)a1, a2)
+SYSCALL_WRAP(sys_write, a0, (const char *)a1, a2)
+SYSCALL_WRAP(sys_pipe, (int *)a0)
+SYSCALL_WRAP(sys_dup2, a0, a1)
+SYSCALL_WRAP(sys_vmsplice, a0, a1, a2)
+SYSCALL_WRAP(sys_ftruncate, a0, a1)
+SYSCALL_WRAP(sys_nanosleep, (const struct timespec *)a0, (struct timespec *)a1)
+SYSCALL_WRAP(sys_sched_setscheduler, a0, a1, a2)
+SYSCALL_WRAP(sys_getpid)
+SYSCALL_WRAP(sys_gettid)
+SYSCALL_WRAP(sys_futex, (uint32_t *)a0, a1, a2)
+SYSCALL_WRAP(sys_brk, a0)
+SYSCALL_WRAP(sys_munmap, a0, a1)
+SYSCALL_WRAP(sys_mmap, a0, a1, a2, a3, a4, a5)
+SYSCALL_WRAP(sys_madvise, a0, a1, a2)
+SYSCALL_WRAP(sys_wait, a0, (int *)a1)
+SYSCALL_WRAP(sys_io_uring_setup, a0, a1, a2)
+SYSCALL_WRAP(sys_io_uring_enter, a0)
+SYSCALL_WRAP(sys_sfs_open, (const char *)a0, a1)
+SYSCALL_WRAP(sys_sfs_close, a0)
+SYSCALL_WRAP(sys_sfs_seek, a0, a1, a2)
+SYSCALL_WRAP(sys_sfs_read, a0, (char *)a1, a2)
+SYSCALL_WRAP(sys_sfs_write, a0, (char *)a1, a2)
+SYSCALL_WRAP(sys_sfs_get_files, (const char *)a0, (char **)a1)
+SYSCALL_WRAP(sys_shm_open, (const char *)a0, a1)
+SYSCALL_WRAP(sys_shm_unlink, (const char *)a0)
+
+const syscall_fn_t sys_call_table[NR_SYSCALLS] = {
+    [SYS_READ] = __sys_read,
+    [SYS_WRITE] = __sys_write,
+    [SYS_PIPE] = __sys_pipe,
+    [SYS_DUP2] = __sys_dup2,
+    [SYS_VMSPLICE] = __sys_vmsplice,
+    [SYS_FTRUNCATE] = __sys_ftruncate,
+    [SYS_NANOSLEEP] = __sys_nanosleep,
+    [SYS_SCHED_SETSCHEDULER] = __sys_sched_setscheduler,
+    [SYS_GETPID] = __sys_getpid,
+    [SYS_GETTID] = __sys_gettid,
+    [SYS_FUTEX] = __sys_futex,
+    [SYS_BRK] = __sys_brk,
+    [SYS_MUNMAP] = __sys_munmap,
+    [SYS_MMAP] = __sys_mmap,
+    [SYS_MADVISE] = __sys_madvise,
+    [SYS_WAIT] = __sys_wait,
+    [SYS_IO_URING_SETUP] = __sys_io_uring_setup,
+    [SYS_IO_URING_ENTER] = __sys_io_uring_enter,
+    [SFS_OPEN] = __sys_sfs_open,
+    [SFS_CLOSE] = __sys_sfs_close,
+    [SFS_SEEK] = __sys_sfs_seek,
+    [SFS_READ] = __sys_sfs_read,
+    [SFS_WRITE] = __sys_sfs_write,
+    [SFS_GET_FILES] = __sys_sfs_get_files,
+    [SYS_SHM_OPEN] = __sys_shm_open,
+    [SYS_SHM_UNLINK] = __sys_shm_unlink,
+};
+
+void syscall_exit(void) {
+    vvar_inc(current, nr_syscalls);
+    // 系统调用中唤醒了更高优先级的进程
+    if (need_resched) {
+        preempt_schedule();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 慢速路径：由 handler_s 调用，sp 指向完整的栈帧
+
+// clone(CLONE_VM)：新线程与当前进程共享页表、VMA 和 vvar 页，有自己的内核栈，
+// 用户栈 stack 由调用者分配。新线程是当前线程的子进程，可以用 wait 回收。
+// regs 是当前线程的栈帧，sepc 已经指向 ecall 的下一条指令，新线程从 clone 返回 0
+static long clone_thread(uint64_t flags, uint64_t stack, uint64_t *regs) {
+    if (stack == 0 || stack % 16) {
+        return -1;
+    }
+    struct files_struct *fs = current->fs;
+    if (flags & CLONE_FILES) {
+        __atomic_add_fetch(&fs->count, 1, __ATOMIC_RELAXED);
+    } else {
+        // 与 fork 一样只继承管道
+        fs = files_alloc();
+        if (fs == NULL) {
+            return -1;
+        }
+        copy_pipes(fs, current->fs);
+    }
+    struct task_struct *p = alloc_task();
+    if (p == NULL) {
+        put_files(fs);
+        return -1;
+    }
+    p->state = TASK_RUNNING;
+    p->priority = current->priority;
+    p->counter = task_timeslice(p);
+    p->policy = current->policy;
+    p->nice = current->nice;
+    p->vruntime = current->vruntime;
+    p->sum_exec_runtime = 0;
+    link_child(p, current);
+    p->exit_code = 0;
+    p->on_rq = 0;
+    p->blocked = 0;
+
+    p->tgid = current->tgid;
+    p->mm = current->mm;
+    __atomic_add_fetch(&p->mm->users, 1, __ATOMIC_RELAXED);
+    p->fs = fs;
+    // ASID 跟着 mm 走，切换时由 check_and_switch_context 填入
+    p->satp = current->satp;
+    p->sscratch = stack;
+    p->vvar = current->vvar;
+
+    fp_flush();
+    memcpy(&p->fp, &current->fp, sizeof(struct fp_state));
+
+    uint64_t *child_regs = (uint64_t*)(TASK_STACK_TOP(p) - 31 * 8);
+    memcpy(child_regs, regs, 31 * 8);
+    child_regs[4] = 0;
+    p->thread.sp = (uint64_t)child_regs;
+    p->thread.ra = (uint64_t)&ret_from_fork;
+
+    wake_up_new_task(p);
+    return p->pid;
+}
+
+// 线程共享的地址空间和 fd 表由最后一个退出的线程释放，不返回
+static void do_exit(long code) {
+    put_files(current->fs);
+    current->fs = NULL;
+    exit_mm();
+
+    exit_notify(code);
+    dequeue_task(current);
+    schedule(0);
 }
 
 struct ret_info syscall(uint64_t syscall_num, uint64_t arg0, uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4, uint64_t arg5, uint64_t sp) {
@@ -50,21 +593,16 @@ struct ret_info syscall(uint64_t syscall_num, uint64_t arg0, uint64_t arg1, uint
 
     struct ret_info ret;
     switch (syscall_num) {
-    case SYS_GETPID: {
-        ret.a0 = getpid();
-        sp_ptr[4] = ret.a0;
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SYS_READ: {
-        ret.a0 = getchar();
-        sp_ptr[4] = ret.a0;
-        sp_ptr[16] += 4;
-        break;
-    }
     case SYS_FORK: {
+        // SYS_FORK 与 Linux 的 clone 同号，arg0 为 CLONE_* 标志：fork 就是标志为 0 的 clone
+        if (arg0 & CLONE_VM) {
+            sp_ptr[16] += 4;
+            sp_ptr[4] = clone_thread(arg0, arg1, sp_ptr);
+            break;
+        }
+
         // TODO:
-        // 1. create new task and set counter, priority and pid (use our task array)
+        // 1. create new task and set counter, priority and pid (see alloc_task)
         // 2. create root page table, set current process's satp
         //   2.1 copy current process's user program address, create mapping for user program
         //   2.2 create mapping for kernel address
@@ -73,25 +611,47 @@ struct ret_info syscall(uint64_t syscall_num, uint64_t arg0, uint64_t arg1, uint
         // 4. copy mm struct and create mapping
         // 5. set current process a0 = new task pid, sepc += 4
         // 6. copy kernel stack (only need trap_s' stack)
-        // 7. set new process a0 = 0, and ra = trap_s_bottom, sp = register number * 8
+        // 7. set new process a0 = 0, and ra = ret_from_fork, sp = register number * 8
 
-        int i = 0;
-        for (i = 0; i < NR_TASKS; i++) {
-            if (!task[i] || task[i]->counter == 0)
-                break;
+        struct mm_struct *mm = mm_alloc();
+        struct files_struct *fs = files_alloc();
+        struct task_struct *p = mm && fs ? alloc_task() : NULL;
+        if (p == NULL) {
+            if (mm) {
+                kfree(mm->vm);
+                kfree(mm);
+            }
+            if (fs) kfree(fs);
+            sp_ptr[4] = -1;
+            sp_ptr[16] += 4;
+            break;
         }
-        if (!task[i])
-            task[i] = (struct task_struct*)(VIRTUAL_ADDR(alloc_page()));
-        task[i]->state = TASK_RUNNING;
-        task[i]->counter = 1000;
-        task[i]->priority = 999;
-        task[i]->blocked = 0;
-        task[i]->pid = i;
+        p->mm = mm;
+        p->fs = fs;
+        p->state = TASK_RUNNING;
+        p->priority = DEFAULT_PRIO;
+        p->counter = task_timeslice(p);
+        // 子进程继承调度类、nice 和 vruntime
+        p->policy = current->policy;
+        p->nice = current->nice;
+        p->vruntime = current->vruntime;
+        p->sum_exec_runtime = 0;
+        p->exit_code = 0;
+        p->on_rq = 0;
+        p->blocked = 0;
 
         uint64_t root_page_table = alloc_page();
-        task[i]->mm.user_program_start = current->mm.user_program_start;
-        task[i]->satp = root_page_table >> 12 | 0x8000000000000000 | (((uint64_t) (task[i]->pid))  << 44);
-        create_mapping((uint64_t*)root_page_table, 0x1000000, task[i]->mm.user_program_start, PAGE_SIZE * 2, PTE_V | PTE_R | PTE_X | PTE_U | PTE_W);
+        if (root_page_table == 0) {
+            kfree(mm->vm);
+            kfree(mm);
+            put_files(fs);
+            free_new_task(p);
+            sp_ptr[4] = -1;
+            sp_ptr[16] += 4;
+            break;
+        }
+        // 子进程的 ASID 在第一次被调度时分配，不再与 pid 绑定
+        p->satp = root_page_table >> 12 | SATP_MODE_SV39;
         // 调用 create_mapping 函数将虚拟地址 0xffffffc000000000 开始的 16 MB 空间映射到起始物理地址为 0x80000000 的 16MB 空间
         create_mapping((uint64_t*)root_page_table, 0xffffffc000000000, 0x80000000, 16 * 1024 * 1024, PTE_V | PTE_R | PTE_W | PTE_X);
         // 修改对内核空间不同 section 所在页属性的设置，完成对不同section的保护，其中text段的权限为 r-x, rodata 段为 r--, 其他段为 rw-。
@@ -109,40 +669,64 @@ struct ret_info syscall(uint64_t syscall_num, uint64_t arg0, uint64_t arg1, uint
         create_mapping((uint64_t*)root_page_table, 0x0c000000L, 0x0c000000L, 20 * 1024 * 1024, PTE_V | PTE_R | PTE_W | PTE_X);
 
         uint64_t physical_stack = alloc_page();
-        task[i]->mm.user_stack = physical_stack;
-        task[i]->sscratch = read_csr(sscratch);
-        create_mapping((uint64_t*)root_page_table, 0x1002000, physical_stack, PAGE_SIZE, PTE_V | PTE_R | PTE_W | PTE_U);
-        memcpy((uint64_t *)physical_stack, (uint64_t *)current->mm.user_stack, PAGE_SIZE);
-
-
-        task[i]->mm.vm = kmalloc(sizeof(struct vm_area_struct));
-
-        INIT_LIST_HEAD(&(task[i]->mm.vm->vm_list));
-
+        p->mm->user_stack = physical_stack;
+        p->sscratch = read_csr(sscratch);
+        int err = physical_stack == 0 || vvar_setup(p, (uint64_t*)root_page_table);
+        if (physical_stack) {
+            create_mapping((uint64_t*)root_page_table, 0x1002000, physical_stack, PAGE_SIZE, PTE_V | PTE_R | PTE_W | PTE_U);
+            memcpy((uint64_t *)physical_stack, (uint64_t *)current->mm->user_stack, PAGE_SIZE);
+        }
 
         struct vm_area_struct* vma;
 
-        list_for_each_entry(vma, &current->mm.vm->vm_list, vm_list) {
+        // 其他线程可能同时在修改 VMA
+        spin_lock(&current->mm->lock);
+        list_for_each_entry(vma, &current->mm->vm->vm_list, vm_list) {
+            // io_uring 的共享环不被子进程继承
+            if (err || (vma->vm_mmap_flags & VM_URING)) {
+                continue;
+            }
             struct vm_area_struct * copy = kmalloc(sizeof(struct vm_area_struct));
-            memcpy(copy, vma, sizeof(struct vm_area_struct));
-            list_add(&(copy->vm_list), &task[i]->mm.vm->vm_list);
-            if (vma->mapped) {
-                uint64_t pa = alloc_pages((vma->vm_end - vma->vm_start) / PAGE_SIZE);
-                create_mapping((uint64_t*)root_page_table, vma->vm_start, pa, vma->vm_end - vma->vm_start, vma->vm_flags);
-                uint64_t pte = get_pte((current->satp & ((1ULL << 44) - 1)) << 12, vma->vm_start);
-                memcpy((uint64_t *)pa, (uint64_t *)((pte >> 10) << 12), vma->vm_end - vma->vm_start);
+            if (copy == NULL) {
+                err = 1;
+                continue;
             }
+            memcpy(copy, vma, sizeof(struct vm_area_struct));
+            insert_vma(p->mm, copy);
+            // 失败时已复制的部分留在子进程的 mm 中，下面一起释放
+            err = copy_vma((uint64_t*)root_page_table, current_pgtbl(), copy, vma);
         }
+        p->mm->start_brk = current->mm->start_brk;
+        p->mm->brk = current->mm->brk;
+        spin_unlock(&current->mm->lock);
 
+        // 子进程继承管道，可以通过它与父进程通信；SFS 文件不继承
+        if (err || copy_pipes(p->fs, current->fs)) {
+            // 子进程还没有挂到父进程上，也没有运行过，直接释放
+            mm_destroy(mm, (uint64_t*)root_page_table, p);
+            put_files(fs);
+            free_new_task(p);
+            sp_ptr[4] = -1;
+            sp_ptr[16] += 4;
+            break;
+        }
+        link_child(p, current);
 
-        sp_ptr[4] = task[i]->pid;
+        // 子进程继承父进程的浮点寄存器
+        fp_flush();
+        memcpy(&p->fp, &current->fp, sizeof(struct fp_state));
+
+        sp_ptr[4] = p->pid;
         sp_ptr[16] += 4;
 
-        memcpy((uint64_t*)((uint64_t)task[i] + PAGE_SIZE - 31 * 8), (uint64_t*)((uint64_t)current + PAGE_SIZE - 31 * 8), 31 * 8);
+        // 复制 trap_s 保存在内核栈顶的寄存器，子进程的返回值为 0
+        uint64_t *child_regs = (uint64_t*)(TASK_STACK_TOP(p) - 31 * 8);
+        memcpy(child_regs, sp_ptr, 31 * 8);
+        child_regs[4] = 0;
+        p->thread.sp = (uint64_t)child_regs;
+        p->thread.ra = (uint64_t)&ret_from_fork;
 
-        *(uint64_t *)((uint64_t)(sp_ptr + 4) - (uint64_t)current + (uint64_t)task[i]) = 0;
-        task[i]->thread.sp = (uint64_t)task[i] + PAGE_SIZE - 31 * 8;
-        task[i]->thread.ra = (uint64_t)&trap_s_bottom;
+        wake_up_new_task(p);
 
         break;
     }
@@ -151,27 +735,34 @@ struct ret_info syscall(uint64_t syscall_num, uint64_t arg0, uint64_t arg1, uint
         // 1. free current process vm_area_struct and it's mapping area
         // 2. reset user stack
         // 3. create mapping for new user program address
-        // 4. set sepc = 0x1000000
+        // 4. set sepc = entry of the new program
 
-        uint64_t root_page_table = (current->satp & ((1ULL << 44) - 1)) << 12;
-        struct vm_area_struct* vma;
-        list_for_each_entry(vma, &current->mm.vm->vm_list, vm_list) {
-            if (vma->mapped == 1) {
-                uint64_t pte = get_pte((uint64_t*)root_page_table, vma->vm_start);
-                free_pages((pte >> 10) << 12);
-            }
-            create_mapping((uint64_t*)root_page_table, vma->vm_start, 0, (vma->vm_end - vma->vm_start), 0);
-            list_del(&(vma->vm_list));
-            kfree(vma);
+        // 路径在用户内存中，释放旧的地址空间之前先拷贝出来
+        char path[EXEC_PATH_MAX];
+        uint64_t entry;
+        // 其他线程还在使用这个地址空间时不能替换它
+        if (__atomic_load_n(&current->mm->users, __ATOMIC_ACQUIRE) > 1 ||
+            copy_exec_path(path, (const char *)arg0)) {
+            sp_ptr[4] = -1;
+            sp_ptr[16] += 4;
+            break;
         }
 
-        write_csr(sscratch, 0x1002000 + PAGE_SIZE);
-
-        current->mm.user_program_start = get_program_address((char *)arg0);
-        create_mapping((uint64_t*)root_page_table, 0x1000000, current->mm.user_program_start, PAGE_SIZE * 2, PTE_V | PTE_R | PTE_X | PTE_U | PTE_W);
+        // 程序段是按需缺页的文件映射，见 exec.h
+        int err = do_execve(path, &entry);
+        if (err == -1) {
+            sp_ptr[4] = -1;
+            sp_ptr[16] += 4;
+            break;
+        }
+        if (err) {
+            printf("[PID = %d] exec %s failed\n", current->pid, path);
+            do_exit(-1);
+        }
 
-        asm volatile ("sfence.vma");
-        sp_ptr[16] = 0x1000000;
+        fp_reset();
+        write_csr(sscratch, 0x1002000 + PAGE_SIZE);
+        sp_ptr[16] = entry;
 
         break;
     }
@@ -180,143 +771,10 @@ struct ret_info syscall(uint64_t syscall_num, uint64_t arg0, uint64_t arg1, uint
         // 1. free current process vm_area_struct and it's mapping area
         // 2. free user stack
         // 3. free page table
-        // 4. clear current task, set current task->counter = 0
+        // 4. become a zombie holding the exit code and wake up the parent
         // 5. call schedule
 
-        uint64_t root_page_table = (current->satp & ((1ULL << 44) - 1)) << 12;
-        struct vm_area_struct* vma;
-        list_for_each_entry(vma, &current->mm.vm->vm_list, vm_list) {
-            if (vma->mapped == 1) {
-                uint64_t pte = get_pte((uint64_t*)root_page_table, vma->vm_start);
-                free_pages((pte >> 10) << 12);
-            }
-            create_mapping((uint64_t*)root_page_table, vma->vm_start, 0, (vma->vm_end - vma->vm_start), 0);
-            list_del(&(vma->vm_list));
-            kfree(vma);
-        }
-        kfree(&(current->mm.vm));
-        current->mm.vm = NULL;
-
-        free_pages(current->mm.user_stack);
-        current->mm.user_stack = 0;
-
-        free_pages(root_page_table);
-
-        current->counter = 0;
-        schedule(0);
-        break;
-    }
-    case SYS_WAIT: {
-        // TODO:
-        // 1. find the process which pid == arg0
-        // 2. if not find
-        //   2.1. sepc += 4, return
-        // 3. if find
-        //   3.1. change current process's priority
-        //   3.2. call schedule to run other process
-        //   3.3. goto 1. check again
-        int exec_finish = 0;
-        while (!exec_finish) {
-            exec_finish = 1;
-            for (int i = 0; i < NR_TASKS; i++) {
-                if (task[i]) {
-                    if (task[i]->pid == arg0 && task[i]->counter > 0) {
-                        current->priority = task[i]->priority + 1;
-                        exec_finish = 0;
-                        schedule(0);
-                    }
-                }
-            }
-        }
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SYS_WRITE: {
-        int fd = arg0;
-        char* buffer = (char*)arg1;
-        int size = arg2;
-        if(fd == 1) {
-            for(int i = 0; i < size; i++) {
-                putchar(buffer[i]);
-            }
-        }
-        ret.a0 = size;
-        sp_ptr[4] = ret.a0;
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SYS_MMAP: {
-        struct vm_area_struct* vma = (struct vm_area_struct*)kmalloc(sizeof(struct vm_area_struct));
-        if (vma == NULL) {
-            ret.a0 = -1;
-            break;
-        }
-        vma->vm_start = arg0;
-        vma->vm_end = arg0 + arg1;
-        vma->vm_flags = arg2;
-        vma->mapped = 0;
-        list_add(&(vma->vm_list), &(current->mm.vm->vm_list));
-
-        ret.a0 = vma->vm_start;
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SYS_MUNMAP: {
-        ret.a0 = -1;
-        struct vm_area_struct* vma;
-        list_for_each_entry(vma, &current->mm.vm->vm_list, vm_list) {
-            if (vma->vm_start == arg0 && vma->vm_end == arg0 + arg1) {
-                if (vma->mapped == 1) {
-                    uint64_t pte = get_pte((current->satp & ((1ULL << 44) - 1)) << 12, vma->vm_start);
-                    free_pages((pte >> 10) << 12);
-                }
-                create_mapping((current->satp & ((1ULL << 44) - 1)) << 12, vma->vm_start, 0, (vma->vm_end - vma->vm_start), 0);
-                list_del(&(vma->vm_list));
-                kfree(vma);
-
-                ret.a0 = 0;
-                break;
-            }
-        }
-        // flash the TLB
-        asm volatile ("sfence.vma");
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SFS_OPEN: {
-        ret.a0 = sfs_open((const char *)arg0, arg1);
-        sp_ptr[4] = ret.a0;
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SFS_READ: {
-        ret.a0 = sfs_read(arg0, (const char *)arg1, arg2);
-        sp_ptr[4] = ret.a0;
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SFS_WRITE: {
-        ret.a0 = sfs_write(arg0, (const char *)arg1, arg2);
-        sp_ptr[4] = ret.a0;
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SFS_SEEK: {
-        ret.a0 = sfs_seek(arg0, arg1, arg2);
-        sp_ptr[4] = ret.a0;
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SFS_GET_FILES: {
-        ret.a0 = sfs_get_files((const char *)arg0, (char **)arg1);
-        sp_ptr[4] = ret.a0;
-        sp_ptr[16] += 4;
-        break;
-    }
-    case SFS_CLOSE: {
-        ret.a0 = sfs_close(arg0);
-        sp_ptr[4] = ret.a0;
-        sp_ptr[16] += 4;
+        do_exit(arg0);
         break;
     }
     default:
@@ -325,4 +783,4 @@ struct ret_info syscall(uint64_t syscall_num, uint64_t arg0, uint64_t arg1, uint
         break;
     }
     return ret;
-}
\ No newline at end of file
+}
@@ -2,39 +2,351 @@
 
 #include "vm.h"
 #include "mm.h"
+#include "pipe.h"
+#include "riscv.h"
+#include "shm.h"
 #include "stdio.h"
+#include "tlb.h"
+#include "sched.h"
+#include "pid.h"
+#include "slub.h"
+#include "vdso.h"
+#include "workqueue.h"
 
-struct task_struct *task[NR_TASKS];
-struct task_struct *current;
+LIST_HEAD(task_list);
+
+struct spinlock tasklist_lock = SPINLOCK_INIT;
+
+static struct kmem_cache *task_struct_cachep;
+
+// 没有父进程回收、自行退出的 task。退出时仍运行在自己的内核栈上，
+// 所以要等它在所有 hart 上都切换出去（on_cpu 为 0）之后再释放
+static LIST_HEAD(dead_tasks);
+
+// 由 kworker 释放 dead_tasks，fork 和 exit 的路径上不再做回收
+static struct work_struct reap_work;
 
 extern uint64_t text_start;
 extern uint64_t rodata_start;
 extern uint64_t data_start;
 extern uint64_t _end;
-extern uint64_t user_program_start;
 
 // get pid of current process
 int getpid() {
-  return current->pid;
+  return current->tgid;
+}
+
+struct task_struct *alloc_task(void) {
+  struct task_struct *p = kmem_cache_alloc(task_struct_cachep);
+  if (p == NULL) {
+    return NULL;
+  }
+  uint64_t stack = alloc_page();
+  if (stack == 0) {
+    kmem_cache_free(p);
+    return NULL;
+  }
+  spin_lock(&tasklist_lock);
+  p->pid = alloc_pid();
+  if (p->pid < 0) {
+    spin_unlock(&tasklist_lock);
+    free_pages(stack);
+    kmem_cache_free(p);
+    return NULL;
+  }
+  p->stack = VIRTUAL_ADDR(stack);
+  // 复用的 task_struct 可能与某个 hart 的 fp_owner 相同
+  p->fp_cpu = -1;
+  p->tgid = p->pid;
+  p->mm = NULL;
+  p->fs = NULL;
+  p->vvar = NULL;
+  attach_pid(p);
+  list_add_tail(&p->tasks, &task_list);
+  spin_unlock(&tasklist_lock);
+  return p;
+}
+
+// 调用者持有 tasklist_lock
+static void free_task(struct task_struct *p) {
+  list_del(&p->tasks);
+  detach_pid(p);
+  free_pid(p->pid);
+  free_pages(PHYSICAL_ADDR(p->stack));
+  kmem_cache_free(p);
+}
+
+void free_new_task(struct task_struct *p) {
+  spin_lock(&tasklist_lock);
+  free_task(p);
+  spin_unlock(&tasklist_lock);
+}
+
+void free_dead_tasks(void) {
+  struct task_struct *p, *tmp;
+  if (list_empty(&dead_tasks)) {
+    return;
+  }
+  spin_lock(&tasklist_lock);
+  list_for_each_entry_safe(p, tmp, &dead_tasks, sibling) {
+    if (p != current && !p->on_cpu) {
+      list_del(&p->sibling);
+      free_task(p);
+    }
+  }
+  spin_unlock(&tasklist_lock);
+}
+
+static void reap_dead_tasks(struct work_struct *work) {
+  free_dead_tasks();
+}
+
+void schedule_reap(void) {
+  if (system_wq) {
+    schedule_work(&reap_work);
+  }
+}
+
+void link_child(struct task_struct *p, struct task_struct *parent) {
+  INIT_LIST_HEAD(&p->children);
+  init_waitqueue_head(&p->wait_chldexit);
+  spin_lock(&tasklist_lock);
+  p->parent = parent;
+  if (parent) {
+    list_add_tail(&p->sibling, &parent->children);
+  } else {
+    INIT_LIST_HEAD(&p->sibling);
+  }
+  spin_unlock(&tasklist_lock);
+}
+
+// 回收僵尸进程，释放它的 task_struct、内核栈和 pid。
+// 子进程可能刚在另一个 hart 上退出，要等它切换出去之后才能释放内核栈
+static void release_task(struct task_struct *p) {
+  while (p->on_cpu) {
+    ipi_poll();
+  }
+  list_del_init(&p->sibling);
+  p->state = TASK_DEAD;
+  free_task(p);
+}
+
+void exit_notify(int code) {
+  spin_lock(&tasklist_lock);
+  // 没有 init 进程来收养孤儿：已退出的子进程直接回收，其余的退出时自行回收
+  struct task_struct *child, *tmp;
+  list_for_each_entry_safe(child, tmp, &current->children, sibling) {
+    if (child->state == TASK_ZOMBIE) {
+      release_task(child);
+    } else {
+      list_del_init(&child->sibling);
+      child->parent = NULL;
+    }
+  }
+
+  current->exit_code = code;
+  if (current->parent) {
+    current->state = TASK_ZOMBIE;
+    wake_up(&current->parent->wait_chldexit);
+  } else {
+    current->state = TASK_DEAD;
+    list_add_tail(&current->sibling, &dead_tasks);
+  }
+  spin_unlock(&tasklist_lock);
+}
+
+long do_wait(long pid, int *status) {
+  spin_lock(&tasklist_lock);
+  while (1) {
+    bool found = 0;
+    struct task_struct *p;
+    list_for_each_entry(p, &current->children, sibling) {
+      if (pid != -1 && p->pid != pid) {
+        continue;
+      }
+      found = 1;
+      if (p->state == TASK_ZOMBIE) {
+        long ret = p->pid;
+        int code = p->exit_code;
+        if (status) {
+          // 写用户内存可能缺页，不能持有 tasklist_lock。僵尸只有 current 能回收，解锁期间 p 不会消失；
+          // 写不进去时不回收，之后还可以再 wait 它
+          spin_unlock(&tasklist_lock);
+          if (fault_in_user((uint64_t)status, sizeof(int), 1)) {
+            return -1;
+          }
+          *status = code;
+          spin_lock(&tasklist_lock);
+        }
+        release_task(p);
+        spin_unlock(&tasklist_lock);
+        return ret;
+      }
+    }
+    if (!found) {
+      spin_unlock(&tasklist_lock);
+      return -1;
+    }
+    // 睡眠直到某个子进程退出，不再占用 CPU
+    sleep_on_locked(&current->wait_chldexit, &tasklist_lock);
+  }
+}
+
+struct mm_struct *mm_alloc(void) {
+  struct mm_struct *mm = kmalloc(sizeof(struct mm_struct));
+  if (mm == NULL) {
+    return NULL;
+  }
+  memset(mm, 0, sizeof(struct mm_struct));
+  vma_init(mm);
+  if (mm->vm == NULL) {
+    kfree(mm);
+    return NULL;
+  }
+  mm->start_brk = mm->brk = USER_HEAP_START;
+  mm->users = 1;
+  spin_lock_init(&mm->lock);
+  return mm;
+}
+
+void exit_mm(void) {
+  struct mm_struct *mm = current->mm;
+  uint64_t *root_page_table = current_pgtbl();
+
+  // 先切换到内核启动页表：其他线程可能还在使用这个地址空间，
+  // 或者释放后的根页表马上被其他 hart 分配走
+  write_csr(satp, this_cpu()->idle->satp);
+  current->satp = this_cpu()->idle->satp;
+  switch_to_idle_mm();
+  current->mm = NULL;
+  if (__atomic_sub_fetch(&mm->users, 1, __ATOMIC_ACQ_REL)) {
+    // vvar 页属于整个进程，由最后一个线程释放
+    current->vvar = NULL;
+    return;
+  }
+  mm_destroy(mm, root_page_table, current);
+}
+
+void mm_destroy(struct mm_struct *mm, uint64_t *root_page_table, struct task_struct *p) {
+  struct vm_area_struct *vma, *tmp;
+  list_for_each_entry_safe(vma, tmp, &mm->vm->vm_list, vm_list) {
+    destroy_vma(mm, root_page_table, vma);
+  }
+  kfree(mm->vm);
+  // fork 失败时用户栈可能还没有分配
+  if (mm->user_stack) {
+    free_pages(mm->user_stack);
+  }
+  vvar_release(p);
+  free_pages((uint64_t)root_page_table);
+  kfree(mm);
+}
+
+struct files_struct *files_alloc(void) {
+  struct files_struct *fs = kmalloc(sizeof(struct files_struct));
+  if (fs) {
+    memset(fs, 0, sizeof(struct files_struct));
+    fs->count = 1;
+    spin_lock_init(&fs->lock);
+  }
+  return fs;
+}
+
+int fd_install(struct files_struct *files, int from, struct file *f) {
+  int fd = -1;
+  spin_lock(&files->lock);
+  for (int i = from; i < 16; i++) {
+    if (!files->fds[i]) {
+      files->fds[i] = f;
+      fd = i;
+      break;
+    }
+  }
+  spin_unlock(&files->lock);
+  return fd;
+}
+
+struct file *fd_remove(struct files_struct *files, int fd, int type) {
+  if (fd < 0 || fd >= 16) {
+    return NULL;
+  }
+  spin_lock(&files->lock);
+  struct file *f = files->fds[fd];
+  if (f && f->type == type) {
+    files->fds[fd] = NULL;
+  } else {
+    f = NULL;
+  }
+  spin_unlock(&files->lock);
+  return f;
+}
+
+struct file *fget(struct files_struct *files, int fd, int type) {
+  if (fd < 0 || fd >= 16) {
+    return NULL;
+  }
+  spin_lock(&files->lock);
+  struct file *f = files->fds[fd];
+  if (f && f->type == type) {
+    __atomic_add_fetch(&f->refs, 1, __ATOMIC_RELAXED);
+  } else {
+    f = NULL;
+  }
+  spin_unlock(&files->lock);
+  return f;
+}
+
+void fput(struct file *f) {
+  if (__atomic_sub_fetch(&f->refs, 1, __ATOMIC_ACQ_REL)) {
+    return;
+  }
+  if (f->type == FILE_PIPE) {
+    pipe_close(f);
+  } else if (f->type == FILE_SHM) {
+    shm_close(f);
+  }
+}
+
+int fd_type(struct files_struct *files, int fd) {
+  if (fd < 0 || fd >= 16) {
+    return -1;
+  }
+  spin_lock(&files->lock);
+  int type = files->fds[fd] ? files->fds[fd]->type : -1;
+  spin_unlock(&files->lock);
+  return type;
+}
+
+void put_files(struct files_struct *fs) {
+  if (__atomic_sub_fetch(&fs->count, 1, __ATOMIC_ACQ_REL)) {
+    return;
+  }
+  exit_pipes(fs);
+  exit_shm(fs);
+  kfree(fs);
 }
 
 // initialize tasks, set member variables
 void task_init(void) {
+  task_struct_cachep = kmem_cache_create("task_struct", sizeof(struct task_struct), 8, 0, NULL);
+  INIT_WORK(&reap_work, reap_dead_tasks);
+
   // only init the first process
-  struct task_struct* new_task = (struct task_struct*)(VIRTUAL_ADDR(alloc_page()));
+  struct task_struct* new_task = alloc_task();
   new_task->state = TASK_RUNNING;
-  new_task->counter = 1000;
-  new_task->priority = 1000;
+  new_task->priority = DEFAULT_PRIO + 1;
+  new_task->counter = task_timeslice(new_task);
+  new_task->policy = SCHED_DEFAULT_POLICY;
+  new_task->nice = 0;
+  new_task->vruntime = 0;
+  new_task->sum_exec_runtime = 0;
   new_task->blocked = 0;
-  new_task->pid = 0;
-  task[0] = new_task;
-  task[0]->thread.sp = (uint64_t)task[0] + PAGE_SIZE; // 内核栈的栈底
-  task[0]->thread.ra = (uint64_t)__init_sepc;
+  link_child(new_task, NULL);
+  new_task->thread.sp = TASK_STACK_TOP(new_task); // 内核栈的栈底
+  new_task->thread.ra = (uint64_t)__init_sepc;
 
-  task[0]->mm.vm = kmalloc(sizeof(struct vm_area_struct));
-  INIT_LIST_HEAD(&(task[0]->mm.vm->vm_list));
-    
-  uint64_t task_addr = PHYSICAL_ADDR((uint64_t)&user_program_start);
+  new_task->mm = mm_alloc();
+  new_task->fs = files_alloc();
 
   // DONE: 完成用户栈的分配，并创建页表项，将用户栈映射到实际的物理地址
   // 1. 为用户栈分配物理页面，使用alloc_page函数
@@ -42,19 +354,19 @@ void task_init(void) {
   // 3. 将task[i]->sscratch指定为虚拟空间下的栈地址，即0x1001000 + PAGE_SIZE（注意栈是从高地址到低地址使用的）
   // 4. 正确设置task[i]->satp，注意设置ASID
   // 5. 将用户栈映射到实际的物理地址，使用create_mapping函数
-  // 6. 将用户程序映射到虚拟地址空间，使用create_mapping函数
+  // 6. 用户程序在第一次被调度时由 exec_init 从 SFS 装入（见 __init_sepc），这里不映射
   // 7. 将将虚拟地址 0xffffffc000000000 开始的 16 MB 空间映射到起始物理地址为 0x80000000 的 16MB 地址空间，注意此时 &rodata_start、... 得到的是虚拟地址还是物理地址？我们需要的是什么地址？
   // 8. 对内核起始地址 0x80000000 的16MB空间做等值映射（将虚拟地址 0x80000000 开始的 16 MB 空间映射到起始物理地址为 0x80000000 的 16MB 空间），PTE_V | PTE_R | PTE_W | PTE_X 为映射的读写权限。
   // 9. 修改对内核空间不同 section 所在页属性的设置，完成对不同section的保护，其中text段的权限为 r-x, rodata 段为 r--, 其他段为 rw-，注意上述两个映射都需要做保护。
   // 10. 将必要的硬件地址（如 0x10000000 为起始地址的 UART ）进行等值映射 ( 可以映射连续 1MB 大小 )，无偏移，PTE_V | PTE_R 为映射的读写权限
   uint64_t physical_stack = alloc_page();
   uint64_t root_page_table = alloc_page();
-  task[0]->mm.user_stack = physical_stack;
-  task[0]->mm.user_program_start = task_addr;
-  task[0]->sscratch = (uint64_t)0x1002000 + PAGE_SIZE;
-  task[0]->satp = root_page_table >> 12 | 0x8000000000000000 | (((uint64_t) (new_task->pid))  << 44);
+  new_task->mm->user_stack = physical_stack;
+  new_task->sscratch = (uint64_t)0x1002000 + PAGE_SIZE;
+  // ASID 在第一次被调度时由 check_and_switch_context 分配
+  new_task->satp = root_page_table >> 12 | SATP_MODE_SV39;
   create_mapping((uint64_t*)root_page_table, 0x1002000, physical_stack, PAGE_SIZE, PTE_V | PTE_R | PTE_W | PTE_U);
-  create_mapping((uint64_t*)root_page_table, 0x1000000, task_addr, PAGE_SIZE * 2, PTE_V | PTE_R | PTE_X | PTE_U | PTE_W);
+  vvar_setup(new_task, (uint64_t*)root_page_table);
 
   // 调用 create_mapping 函数将虚拟地址 0xffffffc000000000 开始的 16 MB 空间映射到起始物理地址为 0x80000000 的 16MB 空间
   create_mapping((uint64_t*)root_page_table, 0xffffffc000000000, 0x80000000, 16 * 1024 * 1024, PTE_V | PTE_R | PTE_W | PTE_X);
@@ -74,5 +386,8 @@ void task_init(void) {
   create_mapping((uint64_t*)root_page_table, 0x10000000, 0x10000000, 1 * 1024 * 1024, PTE_V | PTE_R | PTE_W | PTE_X);
   create_mapping((uint64_t*)root_page_table, 0x0c000000L, 0x0c000000L, 20 * 1024 * 1024, PTE_V | PTE_R | PTE_W | PTE_X);
 
-  printf("[PID = %d] Process Create Successfully!\n", task[0]->pid);
+  new_task->on_rq = 0;
+  enqueue_task(new_task);
+
+  printf("[PID = %d] Process Create Successfully!\n", new_task->pid);
 }
\ No newline at end of file
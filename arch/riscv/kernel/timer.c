@@ -0,0 +1,279 @@
+#include "timer.h"
+#include "bitops.h"
+#include "riscv.h"
+#include "sbi.h"
+#include "sched.h"
+#include "smp.h"
+#include "spinlock.h"
+
+// 每个 hart 都有自己的时钟中断，jiffies 只由 hart 0 维护
+uint64_t jiffies;
+
+// 下一次时钟中断的 mtime 值，按固定间隔累加以避免误差累积
+static uint64_t next_tick[NR_CPUS];
+
+// 进入 tickless idle 时的 mtime
+static uint64_t idle_enter_time[NR_CPUS];
+
+// 当前写入 mtimecmp 的值
+static uint64_t timer_armed[NR_CPUS];
+
+// 分层时间轮：
+// 时间轮的刻度为 mtime >> TIMER_CLK_SHIFT（1.6us）。共 WHEEL_LEVELS 层，每层 64 个槽，
+// 第 level 层的一个槽覆盖 64^level 个刻度。距到期不足 64^(level+1) 个刻度的定时器
+// 放在第 level 层，第 0 层的槽对应唯一的刻度。clk 的低 6*level 位回绕到 0 时，
+// 把第 level 层当前槽中的定时器重新插入（级联到更低的层）。
+// pending 位图记录非空的槽，空闲的刻度可以整段跳过，处理代价只与定时器数量有关。
+#define TIMER_CLK_SHIFT 4
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1UL << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 6
+#define WHEEL_MAX_DELTA ((1UL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+struct timer_base {
+  struct spinlock lock;
+  uint64_t clk;                                   // 下一个要处理的刻度
+  uint64_t pending[WHEEL_LEVELS];                 // 每层非空的槽
+  struct list_head vec[WHEEL_LEVELS][WHEEL_SIZE];
+};
+
+static struct timer_base timer_bases[NR_CPUS];
+
+static void timer_base_init(struct timer_base *base) {
+  spin_lock_init(&base->lock);
+  base->clk = rdtime() >> TIMER_CLK_SHIFT;
+  for (int level = 0; level < WHEEL_LEVELS; level++) {
+    base->pending[level] = 0;
+    for (uint64_t idx = 0; idx < WHEEL_SIZE; idx++) {
+      INIT_LIST_HEAD(&base->vec[level][idx]);
+    }
+  }
+}
+
+static void __add_timer(struct timer_base *base, struct timer_list *timer) {
+  uint64_t expires = (timer->expires + (1UL << TIMER_CLK_SHIFT) - 1) >> TIMER_CLK_SHIFT;
+  // 已经到期的定时器在下一个刻度处理
+  if (expires < base->clk) {
+    expires = base->clk;
+  }
+  // 超出时间轮范围的先放在最高层的最远处，级联时再重新计算
+  if (expires - base->clk > WHEEL_MAX_DELTA) {
+    expires = base->clk + WHEEL_MAX_DELTA;
+  }
+
+  uint64_t delta = expires - base->clk;
+  uint64_t level = 0;
+  while (delta >> (WHEEL_BITS * (level + 1))) {
+    level++;
+  }
+  uint64_t idx = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  list_add_tail(&timer->entry, &base->vec[level][idx]);
+  base->pending[level] |= 1UL << idx;
+  timer->slot = level * WHEEL_SIZE + idx;
+}
+
+static void __detach_timer(struct timer_base *base, struct timer_list *timer) {
+  uint64_t level = timer->slot / WHEEL_SIZE, idx = timer->slot % WHEEL_SIZE;
+  list_del_init(&timer->entry);
+  if (list_empty(&base->vec[level][idx])) {
+    base->pending[level] &= ~(1UL << idx);
+  }
+}
+
+// 把第 level 层当前槽中的定时器重新插入，它们一定会落到更低的层或本层的其他槽
+static void cascade(struct timer_base *base, uint64_t level) {
+  uint64_t idx = (base->clk >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  struct list_head *head = &base->vec[level][idx];
+  while (!list_empty(head)) {
+    struct timer_list *timer = list_first_entry(head, struct timer_list, entry);
+    __detach_timer(base, timer);
+    __add_timer(base, timer);
+  }
+}
+
+// 下一个需要处理的刻度：第 0 层是定时器的到期刻度，更高层是级联的刻度。
+// 没有定时器时返回 ~0UL
+static uint64_t __next_timer_clk(struct timer_base *base) {
+  uint64_t next = ~0UL;
+  for (uint64_t level = 0; level < WHEEL_LEVELS; level++) {
+    uint64_t shift = WHEEL_BITS * level;
+    uint64_t period = 1UL << (shift + WHEEL_BITS);
+    uint64_t pending = base->pending[level];
+    while (pending) {
+      uint64_t idx = __ffs(pending);
+      pending &= pending - 1;
+      uint64_t clk = (base->clk & ~(period - 1)) + (idx << shift);
+      if (clk < base->clk) {
+        clk += period;
+      }
+      if (clk < next) {
+        next = clk;
+      }
+    }
+  }
+  return next;
+}
+
+// 处理 mtime 不晚于 now 的所有刻度
+static void run_timers(uint64_t now) {
+  struct timer_base *base = &timer_bases[smp_processor_id()];
+  uint64_t target = now >> TIMER_CLK_SHIFT;
+
+  spin_lock(&base->lock);
+  while (base->clk <= target) {
+    uint64_t idx = base->clk & WHEEL_MASK;
+    if (idx == 0) {
+      for (uint64_t level = 1; level < WHEEL_LEVELS; level++) {
+        cascade(base, level);
+        if ((base->clk >> (WHEEL_BITS * level)) & WHEEL_MASK) {
+          break;
+        }
+      }
+    }
+
+    struct list_head *head = &base->vec[0][idx];
+    if (list_empty(head)) {
+      // 两个事件之间的刻度上什么都没有，直接跳过
+      uint64_t next = __next_timer_clk(base);
+      if (next <= base->clk) {
+        next = base->clk + 1;
+      }
+      base->clk = next <= target ? next : target + 1;
+      continue;
+    }
+
+    // 回调中可能会取消或添加定时器，每次都从链表头重新取
+    while (!list_empty(head)) {
+      struct timer_list *timer = list_first_entry(head, struct timer_list, entry);
+      void (*fn)(struct timer_list *) = timer->function;
+      __detach_timer(base, timer);
+      spin_unlock(&base->lock);
+      fn(timer);
+      spin_lock(&base->lock);
+    }
+    base->clk++;
+  }
+  spin_unlock(&base->lock);
+}
+
+// 下一个需要唤醒 CPU 的时间点（mtime），没有定时器时为 ~0UL
+static uint64_t next_timer_deadline(void) {
+  struct timer_base *base = &timer_bases[smp_processor_id()];
+  spin_lock(&base->lock);
+  uint64_t next = __next_timer_clk(base);
+  spin_unlock(&base->lock);
+  return next == ~0UL ? next : next << TIMER_CLK_SHIFT;
+}
+
+static void timer_program(uint64_t when) {
+  timer_armed[smp_processor_id()] = when;
+  sbi_set_timer(when);
+}
+
+// 把 mtimecmp 设置为下一个 tick 与最早的定时器中较早的那个
+static void timer_reprogram(void) {
+  uint64_t when = next_timer_deadline();
+  uint64_t tick = next_tick[smp_processor_id()];
+  timer_program(when < tick ? when : tick);
+}
+
+void add_timer(struct timer_list *timer) {
+  uint64_t cpu = smp_processor_id();
+  struct timer_base *base = &timer_bases[cpu];
+
+  spin_lock(&base->lock);
+  timer->cpu = cpu;
+  __add_timer(base, timer);
+  uint64_t when = __next_timer_clk(base) << TIMER_CLK_SHIFT;
+  spin_unlock(&base->lock);
+
+  // 新定时器比已设置的时钟中断更早，需要提前
+  if (when < timer_armed[cpu]) {
+    timer_program(when);
+  }
+}
+
+int del_timer(struct timer_list *timer) {
+  struct timer_base *base = &timer_bases[timer->cpu];
+  int ret = 0;
+  spin_lock(&base->lock);
+  if (timer_pending(timer)) {
+    __detach_timer(base, timer);
+    ret = 1;
+  }
+  spin_unlock(&base->lock);
+  return ret;
+}
+
+struct sleep_timer {
+  struct timer_list timer;
+  struct task_struct *task;
+};
+
+static void process_timeout(struct timer_list *timer) {
+  wake_up_process(container_of(timer, struct sleep_timer, timer)->task);
+}
+
+void schedule_timeout(uint64_t deadline) {
+  struct sleep_timer t;
+  timer_setup(&t.timer, process_timeout);
+  t.timer.expires = deadline;
+  t.task = current;
+
+  // 定时器只会在本 hart 的时钟中断中到期，而 S 态中断是关闭的，
+  // 所以在 schedule 之前不会被唤醒，先设置 state 再挂定时器也没有竞争
+  current->state = TASK_INTERRUPTIBLE;
+  add_timer(&t.timer);
+  schedule(0);
+  del_timer(&t.timer);
+}
+
+void timer_init(void) {
+  uint64_t cpu = smp_processor_id();
+  timer_base_init(&timer_bases[cpu]);
+  next_tick[cpu] = rdtime() + TICK_INTERVAL;
+  timer_program(next_tick[cpu]);
+}
+
+void timer_interrupt(void) {
+  uint64_t cpu = smp_processor_id();
+  uint64_t now = rdtime();
+
+  // 中断也可能是软件定时器到期引起的，只有到了 tick 才推进时间片
+  bool tick = now >= next_tick[cpu];
+  if (tick) {
+    if (cpu == 0) {
+      jiffies++;
+    }
+    next_tick[cpu] += TICK_INTERVAL;
+    if (next_tick[cpu] <= now) {
+      // 中断处理被耽搁太久，错过的 tick 不再补发
+      next_tick[cpu] = now + TICK_INTERVAL;
+    }
+  }
+
+  run_timers(now);
+  timer_reprogram();
+
+  if (tick) {
+    do_timer();
+  }
+}
+
+void tick_nohz_idle_enter(void) {
+  idle_enter_time[smp_processor_id()] = rdtime();
+  timer_program(next_timer_deadline());
+}
+
+void tick_nohz_idle_exit(void) {
+  uint64_t cpu = smp_processor_id();
+  uint64_t now = rdtime();
+  if (cpu == 0) {
+    jiffies += (now - idle_enter_time[cpu]) / TICK_INTERVAL;
+  }
+  next_tick[cpu] = now + TICK_INTERVAL;
+  // 唤醒 idle 的可能是到期的定时器
+  run_timers(now);
+  timer_reprogram();
+}
@@ -0,0 +1,227 @@
+#include "tlb.h"
+#include "mm.h"
+#include "riscv.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "stdio.h"
+#include "task_manager.h"
+
+// ASID 分配器：
+// mm->context_id = generation | asid。同一个 generation 内 ASID 只分配不回收，
+// 因此新分配到的 ASID 在 TLB 中一定没有残留项，切换地址空间时无需 sfence.vma。
+// ASID 用尽时 generation 加一，清空位图并刷新一次整个 TLB（rollover）。
+//
+// 多 hart：mm->cpu_mask 记录 mm 曾在哪些 hart 上运行过（TLB 里可能有它的项）。
+// 刷新时正在运行该 mm 的其他 hart 通过 IPI 同步刷新；其余的只在
+// mm->tlb_stale_mask 中记一笔，等它们下次切换到该 mm 时再刷新。
+//
+// 硬件不支持 ASID（asid_bits 为 0）时所有地址空间共用 ASID 0，
+// TLB 中的项分不清属于哪个 mm，每次切换地址空间都要刷新整个 TLB。
+
+static uint64_t asid_bits;
+static uint64_t num_asids;
+static uint64_t asid_generation = ASID_FIRST_VERSION;
+static uint64_t asid_map[(1UL << ASID_MAX_BITS) / 64];
+static uint64_t next_asid = 1;
+
+// 保护 ASID 分配器以及 active_mm、cpu_mask 等刷新相关状态
+static struct spinlock asid_lock = SPINLOCK_INIT;
+
+// 每个 hart 当前 satp 对应的 mm，运行 idle task 时为 NULL
+static struct mm_struct *active_mm[NR_CPUS];
+
+// rollover 之后还没有刷新整个 TLB 的 hart
+static uint64_t tlb_flush_pending;
+
+// IPI 刷新请求：发起方递增 flush_req，目标 hart 刷新后把看到的值写回 flush_done
+static volatile uint64_t flush_req[NR_CPUS];
+static volatile uint64_t flush_done[NR_CPUS];
+
+#define asid_test(n) (asid_map[(n) / 64] & (1UL << ((n) % 64)))
+#define asid_set(n) (asid_map[(n) / 64] |= (1UL << ((n) % 64)))
+
+void asid_init(void) {
+  // 向 satp.ASID 写入全 1 再读回，得到硬件实际实现的 ASID 位数
+  uint64_t old = read_csr(satp);
+  write_csr(satp, old | (SATP_ASID_MASK << SATP_ASID_SHIFT));
+  uint64_t mask = (read_csr(satp) >> SATP_ASID_SHIFT) & SATP_ASID_MASK;
+  write_csr(satp, old);
+
+  asid_bits = 0;
+  while (mask & 1) {
+    asid_bits++;
+    mask >>= 1;
+  }
+  num_asids = 1UL << asid_bits;
+  if (asid_bits == 0) {
+    printf("[ASID] hardware has no ASID support\n");
+  }
+
+  // ASID 0 保留给内核启动页表
+  asid_set(0);
+}
+
+// generation 翻转：清空位图，保留各 hart 正在运行的地址空间的 ASID，
+// 每个 hart 在下一次切换地址空间时刷新全部 TLB
+static void asid_rollover(void) {
+  asid_generation += ASID_FIRST_VERSION;
+  memset(asid_map, 0, sizeof(asid_map));
+  asid_set(0);
+  next_asid = 1;
+
+  for_each_online_cpu(c) {
+    struct mm_struct *mm = active_mm[c];
+    if (mm && mm->context_id) {
+      uint64_t asid = mm->context_id & SATP_ASID_MASK;
+      asid_set(asid);
+      mm->context_id = asid_generation | asid;
+    }
+  }
+
+  tlb_flush_pending = cpu_online_mask;
+}
+
+static uint64_t new_context(void) {
+  while (1) {
+    for (; next_asid < num_asids; next_asid++) {
+      if (!asid_test(next_asid)) {
+        asid_set(next_asid);
+        return asid_generation | next_asid++;
+      }
+    }
+    asid_rollover();
+    if (num_asids <= 1) {
+      return asid_generation;
+    }
+  }
+}
+
+void check_and_switch_context(struct task_struct *next) {
+  struct mm_struct *mm = next->mm;
+  uint64_t cpu = smp_processor_id();
+
+  spin_lock(&asid_lock);
+  if ((mm->context_id & ~SATP_ASID_MASK) != asid_generation) {
+    mm->context_id = new_context();
+  }
+  next->satp = (next->satp & SATP_PPN_MASK) | SATP_MODE_SV39 |
+               ((mm->context_id & SATP_ASID_MASK) << SATP_ASID_SHIFT);
+
+  if (asid_bits == 0 || (tlb_flush_pending & (1UL << cpu))) {
+    tlb_flush_pending &= ~(1UL << cpu);
+    mm->tlb_stale_mask &= ~(1UL << cpu);
+    local_flush_tlb_all();
+  } else if (mm->tlb_stale_mask & (1UL << cpu)) {
+    // 不在本 hart 上运行期间 mm 的页表被修改过
+    mm->tlb_stale_mask &= ~(1UL << cpu);
+    local_flush_tlb_asid(mm_asid(mm));
+  }
+  mm->cpu_mask |= 1UL << cpu;
+  active_mm[cpu] = mm;
+  spin_unlock(&asid_lock);
+}
+
+void switch_to_idle_mm(void) {
+  spin_lock(&asid_lock);
+  active_mm[smp_processor_id()] = NULL;
+  spin_unlock(&asid_lock);
+}
+
+uint64_t mm_asid(struct mm_struct *mm) {
+  return mm->context_id & SATP_ASID_MASK;
+}
+
+// 若 mm 的 generation 已过期，说明它上次运行之后发生过 rollover，TLB 中不会有它的项
+static bool mm_context_live(struct mm_struct *mm) {
+  return (mm->context_id & ~SATP_ASID_MASK) == asid_generation;
+}
+
+void tlb_flush_ipi(void) {
+  uint64_t cpu = smp_processor_id();
+  uint64_t req = __atomic_load_n(&flush_req[cpu], __ATOMIC_ACQUIRE);
+  local_flush_tlb_all();
+  __atomic_store_n(&flush_done[cpu], req, __ATOMIC_RELEASE);
+}
+
+// 找出需要同步刷新的其他 hart，返回 hart 掩码；mm 不再有效时返回 -1
+static int64_t tlb_flush_prepare(struct mm_struct *mm) {
+  uint64_t self = 1UL << smp_processor_id();
+  uint64_t targets = 0;
+
+  spin_lock(&asid_lock);
+  if (!mm_context_live(mm)) {
+    spin_unlock(&asid_lock);
+    return -1;
+  }
+  uint64_t others = mm->cpu_mask & ~self;
+  for_each_online_cpu(c) {
+    if (!(others & (1UL << c))) {
+      continue;
+    }
+    if (active_mm[c] == mm) {
+      targets |= 1UL << c;
+    } else {
+      mm->tlb_stale_mask |= 1UL << c;
+    }
+  }
+  spin_unlock(&asid_lock);
+  return targets;
+}
+
+// 向 targets 中的 hart 发送刷新请求，等待它们全部完成
+static void smp_flush_tlb(uint64_t targets) {
+  uint64_t ticket[NR_CPUS];
+  if (targets == 0) {
+    return;
+  }
+  for_each_online_cpu(c) {
+    if (targets & (1UL << c)) {
+      ticket[c] = __atomic_add_fetch(&flush_req[c], 1, __ATOMIC_ACQ_REL);
+    }
+  }
+  send_ipi(targets, IPI_TLB_FLUSH);
+  for_each_online_cpu(c) {
+    if (!(targets & (1UL << c))) {
+      continue;
+    }
+    // 对方可能也在等我们刷新，等待时继续处理自己收到的 IPI
+    while ((int64_t)(__atomic_load_n(&flush_done[c], __ATOMIC_ACQUIRE) -
+                     ticket[c]) < 0) {
+      ipi_poll();
+    }
+  }
+}
+
+void flush_tlb_mm(struct mm_struct *mm) {
+  int64_t targets = tlb_flush_prepare(mm);
+  if (targets < 0) {
+    return;
+  }
+  local_flush_tlb_asid(mm_asid(mm));
+  smp_flush_tlb(targets);
+}
+
+void flush_tlb_page(struct mm_struct *mm, uint64_t va) {
+  int64_t targets = tlb_flush_prepare(mm);
+  if (targets < 0) {
+    return;
+  }
+  local_flush_tlb_page(mm_asid(mm), va);
+  smp_flush_tlb(targets);
+}
+
+void flush_tlb_range(struct mm_struct *mm, uint64_t start, uint64_t end) {
+  int64_t targets = tlb_flush_prepare(mm);
+  if (targets < 0) {
+    return;
+  }
+  start = ROUNDDOWN(start, PAGE_SIZE);
+  if ((end - start) / PAGE_SIZE > TLB_FLUSH_PAGE_LIMIT) {
+    local_flush_tlb_asid(mm_asid(mm));
+  } else {
+    for (uint64_t va = start; va < end; va += PAGE_SIZE) {
+      local_flush_tlb_page(mm_asid(mm), va);
+    }
+  }
+  smp_flush_tlb(targets);
+}
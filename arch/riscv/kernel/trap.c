@@ -1,17 +1,26 @@
+#include "console.h"
 #include "defs.h"
+#include "fpu.h"
+#include "io_uring.h"
 #include "mm.h"
 #include "sched.h"
+#include "smp.h"
 #include "stdio.h"
 #include "syscall.h"
 #include "task_manager.h"
+#include "timer.h"
+#include "vdso.h"
 #include "virtio.h"
 #include "vm.h"
 
+// M 模式下运行，返回后 head.S 置位 SSIP 通知 S 模式
 void m_ext_handler() {
   int irq = plic_claim();
-  // virtio disk
-  if (irq == 1) {
-    virtio_disk_intr();
+  if (irq == UART0_IRQ) {
+    console_intr();
+  }
+  if (irq) {
+    plic_complete(irq);
   }
 }
 
@@ -20,8 +29,18 @@ void handler_s(uint64_t cause, uint64_t epc, uint64_t sp) {
   if (cause >> 63 == 1) {
     // supervisor timer interrupt
     if (cause == 0x8000000000000005) {
-      asm volatile("ecall");
-      do_timer();
+      timer_interrupt();
+      // SQPOLL 模式的 io_uring 借时钟中断处理提交队列
+      io_uring_sqpoll();
+    }
+    // supervisor software interrupt: IPI from another hart
+    else if (cause == 0x8000000000000001) {
+      handle_ipi();
+    }
+    // 串口输入由 M 模式放入输入环，在这里唤醒读者
+    console_wakeup();
+    if (need_resched) {
+      preempt_schedule();
     }
   }
   // exception
@@ -43,36 +62,36 @@ void handler_s(uint64_t cause, uint64_t epc, uint64_t sp) {
       // 5. otherwise, print error message and add 4 to the sepc (DONE)
 
       uint64_t *sp_ptr = (uint64_t *)(sp);
+      vvar_inc(current, nr_page_faults);
 
-      struct vm_area_struct *vma;
-      list_for_each_entry(vma, &current->mm.vm->vm_list, vm_list) {
-        if (stval >= vma->vm_start && stval < vma->vm_end) {
-          if ((vma->vm_flags & PTE_V) && (vma->vm_flags & PTE_U) &&
-              (((vma->vm_flags & PTE_X) && cause == 0xc) ||
-               ((vma->vm_flags & PTE_R) && cause == 0xd) ||
-               ((vma->vm_flags & PTE_R) && (vma->vm_flags & PTE_W) &&
-                cause == 0xf))) {
+      // 同一地址空间的其他线程可能同时在缺页或修改 VMA
+      spin_lock(&current->mm->lock);
+      struct vm_area_struct *vma = find_vma(current->mm, stval);
+      if (vma) {
+        if ((vma->vm_flags & PTE_V) && (vma->vm_flags & PTE_U) &&
+            (((vma->vm_flags & PTE_X) && cause == 0xc) ||
+             ((vma->vm_flags & PTE_R) && cause == 0xd) ||
+             ((vma->vm_flags & PTE_R) && (vma->vm_flags & PTE_W) &&
+              cause == 0xf))) {
 
-            uint64_t pa =
-                alloc_pages((vma->vm_end - vma->vm_start) / PAGE_SIZE);
-            if (pa == 0) {
-              printf("alloc_pages failed!\n");
-              sp_ptr[16] += 4;
-              return;
-            }
-            create_mapping((current->satp & ((1ULL << 44) - 1)) << 12,
-                           vma->vm_start, pa, (vma->vm_end - vma->vm_start),
-                           vma->vm_flags);
-            vma->mapped = 1;
-            return;
-          } else {
-            printf("Invalid permission! scause: %llx flags: %llx \n", cause,
-                   vma->vm_flags);
+          uint64_t *pgtbl = current_pgtbl();
+          int ret = handle_vma_fault(current->mm, pgtbl, vma, stval, cause == 0xf);
+          spin_unlock(&current->mm->lock);
+          if (ret) {
+            printf("Page fault handling failed! addr = 0x%016lx\n", stval);
             sp_ptr[16] += 4;
-            return;
           }
+          return;
+        } else {
+          uint64_t flags = vma->vm_flags;
+          spin_unlock(&current->mm->lock);
+          printf("Invalid permission! scause: %llx flags: %llx \n", cause,
+                 flags);
+          sp_ptr[16] += 4;
+          return;
         }
       }
+      spin_unlock(&current->mm->lock);
       printf("Unhandled page fault! addr = 0x%016lx\n", stval);
       sp_ptr[16] += 4;
       return;
@@ -94,7 +113,16 @@ void handler_s(uint64_t cause, uint64_t epc, uint64_t sp) {
       uint64_t arg0 = sp_ptr[4], arg1 = sp_ptr[5], arg2 = sp_ptr[6],
                arg3 = sp_ptr[7], arg4 = sp_ptr[8], arg5 = sp_ptr[9];
 
+      vvar_inc(current, nr_syscalls);
       syscall(syscall_num, arg0, arg1, arg2, arg3, arg4, arg5, sp);
+      // 系统调用中唤醒了更高优先级的进程
+      if (need_resched) {
+        preempt_schedule();
+      }
+    }
+    // illegal instruction: 浮点单元关闭时第一次使用浮点，恢复浮点状态后重新执行
+    else if (cause == 0x2 && fp_trap()) {
+      return;
     } else {
       printf("Unknown exception! epc = 0x%016lx\n", epc);
       while (1)
@@ -0,0 +1,33 @@
+#include "vdso.h"
+#include "mm.h"
+#include "riscv.h"
+#include "task_manager.h"
+#include "timer.h"
+#include "vm.h"
+
+static uint64_t clock_base;
+
+void vdso_init(void) {
+  clock_base = rdtime();
+}
+
+int vvar_setup(struct task_struct *p, uint64_t *pgtbl) {
+  struct vvar_data *vvar = (struct vvar_data *)alloc_page();
+  if (vvar == NULL) {
+    return -1;
+  }
+  memset(vvar, 0, PAGE_SIZE);
+  vvar->timebase_freq = TIMEBASE_FREQ;
+  vvar->clock_base = clock_base;
+  vvar->pid = p->pid;
+  create_mapping(pgtbl, VVAR_ADDR, (uint64_t)vvar, PAGE_SIZE, PTE_V | PTE_R | PTE_U);
+  p->vvar = vvar;
+  return 0;
+}
+
+void vvar_release(struct task_struct *p) {
+  if (p->vvar) {
+    free_pages((uint64_t)p->vvar);
+    p->vvar = NULL;
+  }
+}
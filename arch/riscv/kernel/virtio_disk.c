@@ -310,22 +310,12 @@ virtio_disk_intr()
 }
 
 
-static inline uint64_t r_tp() {
-  uint64_t x;
-  asm volatile("mv %0, tp" : "=r"(x));
-  return x;
-}
-
-static int cpuid() {
-  int id = r_tp();
-  return id;
-}
-
 void plic_init() {
   *(uint32_t *)(PLIC + UART0_IRQ * 4) = 1;
-  *(uint32_t *)(PLIC + VIRTIO0_IRQ * 4) = 1;
-  int hart = cpuid();
-  *(uint32_t *)PLIC_SENABLE(hart) = (1 << UART0_IRQ) | (1 << VIRTIO0_IRQ);
+  // 外部中断只路由给 hart 0。磁盘请求由 virtio_disk_rw 轮询完成，不使能它的中断，
+  // 否则 M 模式的 virtio_disk_intr 会与轮询循环争抢 used ring
+  int hart = smp_processor_id();
+  *(uint32_t *)PLIC_SENABLE(hart) = 1 << UART0_IRQ;
   *(uint32_t *)PLIC_SPRIORITY(hart) = 0;
 }
 
@@ -333,4 +323,9 @@ int plic_claim(void) {
   int hart = 0;
   int irq = *(uint32_t *)PLIC_SCLAIM(hart);
   return irq;
+}
+
+void plic_complete(int irq) {
+  int hart = 0;
+  *(uint32_t *)PLIC_SCLAIM(hart) = irq;
 }
\ No newline at end of file
@@ -2,12 +2,16 @@
 #include "mm.h"
 #include "sched.h"
 #include "stdio.h"
+#include "task_manager.h"
+#include "tlb.h"
+#include "filemap.h"
+#include "io_uring.h"
+#include "shm.h"
 
 extern uint64_t text_start;
 extern uint64_t rodata_start;
 extern uint64_t data_start;
 extern uint64_t _end;
-extern uint64_t user_program_start;
 
 void create_mapping(uint64_t *pgtbl, uint64_t va, uint64_t pa, uint64_t sz,
                     int perm) {
@@ -93,6 +97,322 @@ uint64_t get_pte(uint64_t *pgtbl, uint64_t va) {
   return third_page[third_index];
 }
 
+void vma_init(struct mm_struct *mm) {
+  mm->vm = kmalloc(sizeof(struct vm_area_struct));
+  INIT_LIST_HEAD(&(mm->vm->vm_list));
+  mm->mm_rb = RB_ROOT;
+  mm->mmap_cache = NULL;
+}
+
+struct vm_area_struct *find_vma(struct mm_struct *mm, uint64_t addr) {
+  // 同一区域内的连续缺页直接命中缓存
+  struct vm_area_struct *vma = mm->mmap_cache;
+  if (vma && addr >= vma->vm_start && addr < vma->vm_end) {
+    return vma;
+  }
+
+  struct rb_node *node = mm->mm_rb.rb_node;
+  while (node) {
+    vma = rb_entry(node, struct vm_area_struct, vm_rb);
+    if (addr < vma->vm_start) {
+      node = node->rb_left;
+    } else if (addr >= vma->vm_end) {
+      node = node->rb_right;
+    } else {
+      mm->mmap_cache = vma;
+      return vma;
+    }
+  }
+  return NULL;
+}
+
+struct vm_area_struct *find_vma_next(struct mm_struct *mm, uint64_t addr) {
+  struct vm_area_struct *found = NULL;
+  struct rb_node *node = mm->mm_rb.rb_node;
+  while (node) {
+    struct vm_area_struct *vma = rb_entry(node, struct vm_area_struct, vm_rb);
+    if (addr < vma->vm_end) {
+      found = vma;
+      if (addr >= vma->vm_start) {
+        break;
+      }
+      node = node->rb_left;
+    } else {
+      node = node->rb_right;
+    }
+  }
+  return found;
+}
+
+void insert_vma(struct mm_struct *mm, struct vm_area_struct *vma) {
+  struct rb_node **link = &mm->mm_rb.rb_node, *parent = NULL;
+  while (*link) {
+    parent = *link;
+    if (vma->vm_start < rb_entry(parent, struct vm_area_struct, vm_rb)->vm_start) {
+      link = &parent->rb_left;
+    } else {
+      link = &parent->rb_right;
+    }
+  }
+  rb_link_node(&vma->vm_rb, parent, link);
+  rb_insert_color(&vma->vm_rb, &mm->mm_rb);
+
+  // vm_list 保持按地址有序：插在树中前驱之后
+  struct rb_node *prev = rb_prev(&vma->vm_rb);
+  if (prev) {
+    list_add(&vma->vm_list, &rb_entry(prev, struct vm_area_struct, vm_rb)->vm_list);
+  } else {
+    list_add(&vma->vm_list, &mm->vm->vm_list);
+  }
+}
+
+void remove_vma(struct mm_struct *mm, struct vm_area_struct *vma) {
+  rb_erase(&vma->vm_rb, &mm->mm_rb);
+  list_del(&vma->vm_list);
+  if (mm->mmap_cache == vma) {
+    mm->mmap_cache = NULL;
+  }
+}
+
+// VM_PAGED 区域：只为 addr 所在的一页分配物理页
+static int fault_paged(uint64_t *pgtbl, struct vm_area_struct *vma,
+                       uint64_t addr) {
+  uint64_t va = ROUNDDOWN(addr, PAGE_SIZE);
+  if (get_pte(pgtbl, va) & PTE_V) {
+    return 0;
+  }
+  uint64_t pa = alloc_page();
+  if (pa == 0) {
+    return -1;
+  }
+  memset((void *)pa, 0, PAGE_SIZE);
+  create_mapping(pgtbl, va, pa, PAGE_SIZE, vma->vm_flags);
+  vma->mapped = 1;
+  return 0;
+}
+
+// VM_PAGED 区域：释放 [start, end) 内已分配的页
+static void zap_paged(struct mm_struct *mm, uint64_t *pgtbl,
+                      uint64_t start, uint64_t end) {
+  for (uint64_t va = start; va < end; va += PAGE_SIZE) {
+    uint64_t pte = get_pte(pgtbl, va);
+    if (pte & PTE_V) {
+      free_pages((pte >> 10) << 12);
+      create_mapping(pgtbl, va, 0, PAGE_SIZE, 0);
+    }
+  }
+  flush_tlb_range(mm, start, end);
+}
+
+int handle_vma_fault(struct mm_struct *mm, uint64_t *pgtbl,
+                     struct vm_area_struct *vma, uint64_t addr, bool write) {
+  if (vma->vm_pages) {
+    return filemap_fault(mm, pgtbl, vma, addr, write);
+  }
+  if (vma->vm_shm) {
+    return shm_fault(pgtbl, vma, addr);
+  }
+  if (vma->vm_mmap_flags & VM_PAGED) {
+    return fault_paged(pgtbl, vma, addr);
+  }
+  return populate_vma(pgtbl, vma);
+}
+
+int populate_vma(uint64_t *pgtbl, struct vm_area_struct *vma) {
+  if (vma->vm_pages) {
+    return filemap_populate(current->mm, pgtbl, vma);
+  }
+  if (vma->vm_shm) {
+    return shm_populate(pgtbl, vma);
+  }
+  if (vma->vm_mmap_flags & VM_PAGED) {
+    for (uint64_t va = vma->vm_start; va < vma->vm_end; va += PAGE_SIZE) {
+      if (fault_paged(pgtbl, vma, va)) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+  if (vma->mapped) {
+    return 0;
+  }
+  uint64_t pa = alloc_pages((vma->vm_end - vma->vm_start) / PAGE_SIZE);
+  if (pa == 0) {
+    return -1;
+  }
+  create_mapping(pgtbl, vma->vm_start, pa, (vma->vm_end - vma->vm_start),
+                 vma->vm_flags);
+  vma->mapped = 1;
+  return 0;
+}
+
+void zap_vma(struct mm_struct *mm, uint64_t *pgtbl, struct vm_area_struct *vma) {
+  if (vma->vm_mmap_flags & VM_URING) {
+    // 环的页属于 ctx，可能还有线程在提交，这里只解除映射，页随 ctx 的最后一个引用释放
+    create_mapping(pgtbl, vma->vm_start, 0, (vma->vm_end - vma->vm_start), 0);
+    flush_tlb_range(mm, vma->vm_start, vma->vm_end);
+    io_uring_release(mm);
+    vma->mapped = 0;
+    return;
+  }
+  if (vma->vm_pages) {
+    filemap_zap(mm, pgtbl, vma);
+    return;
+  }
+  if (vma->vm_shm) {
+    shm_zap(mm, pgtbl, vma);
+    return;
+  }
+  if (vma->vm_mmap_flags & VM_PAGED) {
+    zap_paged(mm, pgtbl, vma->vm_start, vma->vm_end);
+    vma->mapped = 0;
+    return;
+  }
+  if (vma->mapped) {
+    uint64_t pte = get_pte(pgtbl, vma->vm_start);
+    free_pages((pte >> 10) << 12);
+    vma->mapped = 0;
+  }
+  create_mapping(pgtbl, vma->vm_start, 0, (vma->vm_end - vma->vm_start), 0);
+  flush_tlb_range(mm, vma->vm_start, vma->vm_end);
+}
+
+int fault_in_user(uint64_t addr, uint64_t len, bool write) {
+  struct mm_struct *mm = current->mm;
+  uint64_t *pgtbl = current_pgtbl();
+  int ret = 0;
+  if (addr + len < addr) {
+    return -1;
+  }
+  spin_lock(&mm->lock);
+  for (uint64_t va = ROUNDDOWN(addr, PAGE_SIZE); va < addr + len; va += PAGE_SIZE) {
+    uint64_t pte = get_pte(pgtbl, va);
+    // 用户栈不属于任何 VMA，但总是已映射的
+    if ((pte & PTE_V) && (pte & PTE_U) && (!write || (pte & PTE_W))) {
+      continue;
+    }
+    struct vm_area_struct *vma = find_vma(mm, va);
+    if (vma == NULL || !(vma->vm_flags & PTE_U) ||
+        (write && !(vma->vm_flags & PTE_W)) ||
+        handle_vma_fault(mm, pgtbl, vma, va, write)) {
+      ret = -1;
+      break;
+    }
+  }
+  spin_unlock(&mm->lock);
+  return ret;
+}
+
+int copy_str_from_user(char *dst, const char *src, uint64_t size) {
+  for (uint64_t i = 0; i < size; i++) {
+    uint64_t va = (uint64_t)(src + i);
+    if ((i == 0 || va % PAGE_SIZE == 0) && fault_in_user(va, 1, 0)) {
+      return -1;
+    }
+    dst[i] = src[i];
+    if (dst[i] == '\0') {
+      return 0;
+    }
+  }
+  return -1;
+}
+
+void destroy_vma(struct mm_struct *mm, uint64_t *pgtbl, struct vm_area_struct *vma) {
+  zap_vma(mm, pgtbl, vma);
+  remove_vma(mm, vma);
+  if (vma->vm_pages) {
+    kfree(vma->vm_pages);
+  }
+  if (vma->vm_shm) {
+    shm_put(vma->vm_shm);
+  }
+  kfree(vma);
+}
+
+int copy_vma(uint64_t *dst_pgtbl, uint64_t *src_pgtbl,
+             struct vm_area_struct *dst, struct vm_area_struct *src) {
+  if (src->vm_pages) {
+    return filemap_copy(dst_pgtbl, src_pgtbl, dst, src);
+  }
+  if (src->vm_shm) {
+    return shm_copy(dst_pgtbl, src_pgtbl, dst, src);
+  }
+  if (src->vm_mmap_flags & VM_PAGED) {
+    for (uint64_t va = src->vm_start; va < src->vm_end; va += PAGE_SIZE) {
+      uint64_t pte = get_pte(src_pgtbl, va);
+      if (!(pte & PTE_V)) {
+        continue;
+      }
+      uint64_t pa = alloc_page();
+      if (pa == 0) {
+        return -1;
+      }
+      memcpy((void *)pa, (void *)((pte >> 10) << 12), PAGE_SIZE);
+      create_mapping(dst_pgtbl, va, pa, PAGE_SIZE, src->vm_flags);
+    }
+    return 0;
+  }
+  if (src->mapped) {
+    uint64_t pa = alloc_pages((src->vm_end - src->vm_start) / PAGE_SIZE);
+    if (pa == 0) {
+      // dst 的 mapped 是从 src 复制来的，清掉才能被 destroy_vma 安全释放
+      dst->mapped = 0;
+      return -1;
+    }
+    create_mapping(dst_pgtbl, src->vm_start, pa, src->vm_end - src->vm_start, src->vm_flags);
+    uint64_t pte = get_pte(src_pgtbl, src->vm_start);
+    memcpy((void *)pa, (void *)((pte >> 10) << 12), src->vm_end - src->vm_start);
+  }
+  return 0;
+}
+
+uint64_t do_brk(struct mm_struct *mm, uint64_t *pgtbl, uint64_t addr) {
+  // 堆不能长进 PLIC、UART 和内核的等值映射。USER_MMAP_END 按页对齐，先比较 addr 避免取整溢出
+  if (addr < mm->start_brk || addr > USER_MMAP_END) {
+    return mm->brk;
+  }
+
+  uint64_t old_end = ROUNDUP(mm->brk, PAGE_SIZE);
+  uint64_t new_end = ROUNDUP(addr, PAGE_SIZE);
+  struct vm_area_struct *heap = find_vma(mm, mm->start_brk);
+
+  if (new_end > old_end) {
+    // 新的堆顶不能覆盖其他映射区域
+    struct vm_area_struct *next = find_vma_next(mm, old_end);
+    if (next && next != heap && next->vm_start < new_end) {
+      return mm->brk;
+    }
+    if (heap == NULL) {
+      heap = kmalloc(sizeof(struct vm_area_struct));
+      if (heap == NULL) {
+        return mm->brk;
+      }
+      heap->vm_start = mm->start_brk;
+      heap->vm_end = new_end;
+      heap->vm_flags = PTE_V | PTE_R | PTE_W | PTE_U;
+      heap->mapped = 0;
+      heap->vm_mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS | VM_PAGED;
+      heap->vm_ino = 0;
+      heap->vm_pgoff = 0;
+      heap->vm_pages = NULL;
+      heap->vm_shm = NULL;
+      insert_vma(mm, heap);
+    } else {
+      heap->vm_end = new_end;
+    }
+  } else if (new_end < old_end && heap) {
+    if (new_end == heap->vm_start) {
+      destroy_vma(mm, pgtbl, heap);
+    } else {
+      zap_paged(mm, pgtbl, new_end, old_end);
+      heap->vm_end = new_end;
+    }
+  }
+
+  mm->brk = addr;
+  return mm->brk;
+}
+
 void paging_init() {
   // 在 vm.c 中编写 paging_init 函数，该函数完成以下工作：
   // 1. 创建内核的虚拟地址空间，调用 create_mapping 函数将虚拟地址
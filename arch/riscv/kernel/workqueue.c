@@ -0,0 +1,85 @@
+#include "workqueue.h"
+#include "kthread.h"
+#include "sched.h"
+#include "slub.h"
+#include "stdio.h"
+
+struct workqueue_struct *system_wq;
+
+// system_wq 的 worker 数
+#define SYSTEM_WQ_WORKERS 1
+
+static int worker_thread(void *arg) {
+  struct workqueue_struct *wq = arg;
+
+  spin_lock(&wq->lock);
+  while (1) {
+    while (list_empty(&wq->worklist)) {
+      sleep_on_locked(&wq->more_work, &wq->lock);
+    }
+    struct work_struct *work =
+        list_first_entry(&wq->worklist, struct work_struct, entry);
+    list_del_init(&work->entry);
+    // 执行期间可以再次入队
+    work->pending = 0;
+    spin_unlock(&wq->lock);
+
+    work->func(work);
+    cond_resched();
+
+    spin_lock(&wq->lock);
+    if (--wq->nr_active == 0) {
+      wake_up(&wq->flush_wait);
+    }
+  }
+  return 0;
+}
+
+struct workqueue_struct *create_workqueue(const char *name, int nr_workers) {
+  struct workqueue_struct *wq = kmalloc(sizeof(struct workqueue_struct));
+  if (wq == NULL) {
+    return NULL;
+  }
+  wq->name = name;
+  spin_lock_init(&wq->lock);
+  INIT_LIST_HEAD(&wq->worklist);
+  wq->nr_active = 0;
+  init_waitqueue_head(&wq->more_work);
+  init_waitqueue_head(&wq->flush_wait);
+
+  for (int i = 0; i < nr_workers; i++) {
+    if (kthread_run(worker_thread, wq, name) == NULL) {
+      printf("[WQ] failed to create worker for %s\n", name);
+      break;
+    }
+  }
+  return wq;
+}
+
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work) {
+  spin_lock(&wq->lock);
+  if (work->pending) {
+    spin_unlock(&wq->lock);
+    return 0;
+  }
+  work->pending = 1;
+  list_add_tail(&work->entry, &wq->worklist);
+  wq->nr_active++;
+  spin_unlock(&wq->lock);
+
+  // worker 检查 worklist 和挂到 more_work 上都在 wq->lock 内，这里不会丢失唤醒
+  wake_up(&wq->more_work);
+  return 1;
+}
+
+void flush_workqueue(struct workqueue_struct *wq) {
+  spin_lock(&wq->lock);
+  while (wq->nr_active) {
+    sleep_on_locked(&wq->flush_wait, &wq->lock);
+  }
+  spin_unlock(&wq->lock);
+}
+
+void workqueue_init(void) {
+  system_wq = create_workqueue("kworker", SYSTEM_WQ_WORKERS);
+}
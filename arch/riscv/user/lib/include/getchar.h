@@ -1,3 +1,12 @@
 #pragma once
+#include "types.h"
 
-int getchar();
\ No newline at end of file
+/* 从 fd 读取最多 count 个字节，支持标准输入（fd 0）和管道。
+ * 没有输入时阻塞，有输入时尽量一次读完，返回读到的字节数，出错返回 -1 */
+long read(int fd, void *buf, size_t count);
+
+/* 向 fd 写入 count 个字节：fd 1 为标准输出，也可以是管道，返回写入的字节数，出错返回 -1 */
+long write(int fd, const void *buf, size_t count);
+
+/* 读取一个字符，阻塞直到有输入 */
+int getchar();
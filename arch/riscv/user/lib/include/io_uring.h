@@ -0,0 +1,69 @@
+#pragma once
+
+#include "types.h"
+
+/*
+ * 批量提交 SFS 操作的共享环，结构与内核 include/io_uring.h 一致。
+ * 用法：io_uring_queue_init 建立环；io_uring_get_sqe 取一个空闲 SQE，
+ * 用 io_uring_prep_* 填好；io_uring_submit 一次陷入内核处理全部已填的 SQE；
+ * io_uring_peek_cqe 取结果，io_uring_cqe_seen 归还。
+ * 带 IORING_SETUP_SQPOLL 建立的环，io_uring_submit 不陷入内核，由内核在时钟中断中处理。
+ */
+
+#define IORING_SETUP_SQPOLL 0x1
+
+struct io_uring_sqe {
+  uint64_t opcode; // SFS_* 系统调用号
+  uint64_t args[3];
+  uint64_t user_data;
+};
+
+struct io_uring_cqe {
+  uint64_t user_data;
+  long res;
+};
+
+struct io_rings {
+  uint32_t sq_head;
+  uint32_t sq_tail;
+  uint32_t sq_mask;
+  uint32_t sq_entries;
+  uint32_t cq_head;
+  uint32_t cq_tail;
+  uint32_t cq_mask;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_off;
+  uint32_t cq_off;
+  uint32_t resv;
+};
+
+struct io_uring {
+  struct io_rings *rings;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  uint32_t sqe_tail; // 已填好但还没有提交的 SQE 的末尾
+};
+
+/* 在 addr（页对齐）处建立 entries（2 的幂，不超过 256）项的环，成功返回 0 */
+int io_uring_queue_init(void *addr, uint32_t entries, uint32_t flags,
+                        struct io_uring *ring);
+
+/* 取一个空闲的 SQE，SQ 已满时返回 0 */
+struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring);
+
+/* 提交已填好的 SQE，返回内核处理的个数；SQPOLL 模式下只发布，返回待处理的个数 */
+int io_uring_submit(struct io_uring *ring);
+
+/* 取下一个完成的 CQE，没有时返回 0 */
+struct io_uring_cqe *io_uring_peek_cqe(struct io_uring *ring);
+
+/* 归还 io_uring_peek_cqe 取到的 CQE */
+void io_uring_cqe_seen(struct io_uring *ring);
+
+/* 填写 SQE，参数与对应的 sfs_* 函数相同 */
+void io_uring_prep_open(struct io_uring_sqe *sqe, const char *path, uint32_t flags);
+void io_uring_prep_close(struct io_uring_sqe *sqe, int fd);
+void io_uring_prep_seek(struct io_uring_sqe *sqe, int fd, int off, int fromwhere);
+void io_uring_prep_read(struct io_uring_sqe *sqe, int fd, char *buf, uint32_t len);
+void io_uring_prep_write(struct io_uring_sqe *sqe, int fd, char *buf, uint32_t len);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "types.h"
+
+void *malloc(size_t size);
+
+void free(void *ptr);
+
+void *calloc(size_t nmemb, size_t size);
+
+void *realloc(void *ptr, size_t size);
+
+#define MALLOC_NR_CLASSES 8
+
+// 每个线程的小对象缓存：大多数 malloc/free 只操作它，不碰共享的空闲链表，也不加锁。
+// thread_create 把它放在新线程的栈顶并让 tp 指向它，主线程的 tp 为 0，用一个静态的缓存
+struct malloc_tcache {
+  struct free_obj *lists[MALLOC_NR_CLASSES];
+  uint32_t counts[MALLOC_NR_CLASSES];
+};
+
+/* 线程退出前调用，把当前线程缓存的对象还给共享的空闲链表 */
+void malloc_thread_exit(void);
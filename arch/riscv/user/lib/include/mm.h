@@ -8,7 +8,23 @@
 #define PTE_X 0x008 // Execute
 #define PTE_U 0x010 // User
 
+#define MAP_SHARED 0x01
+#define MAP_PRIVATE 0x02
+#define MAP_ANONYMOUS 0x20
+#define MAP_POPULATE 0x8000 // 在 mmap 时预先建立映射
+
+#define MADV_NORMAL 0
+#define MADV_WILLNEED 3 // 预先建立映射
+#define MADV_DONTNEED 4 // 释放物理页，保留映射区域
+
 void *mmap(void *__addr, size_t __len, int __prot, int __flags, int __fd,
            __off_t __offset);
 
 int munmap(void *__addr, size_t __len);
+
+/* 只支持 MADV_WILLNEED 和 MADV_DONTNEED，其他 advice 返回 -1 */
+int madvise(void *__addr, size_t __len, int __advice);
+
+int brk(void *__addr);
+
+void *sbrk(intptr_t __increment);
@@ -0,0 +1,17 @@
+#pragma once
+#include "types.h"
+
+/* 创建管道，fds[0] 为读端，fds[1] 为写端，成功返回 0。
+ * 管道 fd 可以用 read/write 或 sfs_read/sfs_write 读写，用 close 或 sfs_close 关闭，fork 时子进程继承 */
+int pipe(int fds[2]);
+
+/* 让 newfd 指向管道 oldfd 的同一端，例如 dup2(fds[1], 1) 把标准输出接到管道上 */
+int dup2(int oldfd, int newfd);
+
+/* 关闭 fd */
+int close(int fd);
+
+/* 在用户内存和管道之间整页搬运：fd 为写端时 buf 中按页对齐的整页被移入管道，
+ * 之后这些页读出来是 0；fd 为读端时管道中的整页直接映射到 buf。
+ * 只对堆上的页有效，其余部分按普通读写处理。返回处理的字节数 */
+long vmsplice(int fd, void *buf, size_t len);
@@ -2,7 +2,16 @@
 
 #include "syscall.h"
 
+/* 调度类，与内核 task_manager.h 中的定义一致 */
+#define SCHED_PRIO 0
+#define SCHED_FAIR 1
+
 int fork();
 void wait(int pid);
+/* 等待子进程 pid（-1 表示任意子进程）退出，退出码存入 *status，返回子进程 pid，出错返回 -1 */
+int waitpid(int pid, int *status);
 void exit(int ret);
-void exec(const char * path);
\ No newline at end of file
+void exec(const char * path);
+
+/* 修改进程的调度类，param 对 SCHED_PRIO 为优先级 [0, 64)，对 SCHED_FAIR 为 nice [-20, 19] */
+int sched_setscheduler(int pid, int policy, int param);
@@ -0,0 +1,19 @@
+#pragma once
+#include "types.h"
+
+/* shm_open 的 oflag */
+#define O_RDONLY 0x0
+#define O_RDWR 0x2
+#define O_CREAT 0x40 // 不存在时创建
+#define O_EXCL 0x80  // 与 O_CREAT 一起使用，已存在时失败
+
+/* 打开名为 name 的共享内存对象（最长 31 个字符），返回 fd，失败返回 -1。
+ * 新建的对象大小为 0，用 ftruncate 设置大小后以 MAP_SHARED 映射，
+ * 映射同一对象的进程看到的是同一批物理页。fd 不再需要时用 close 关闭，映射不受影响 */
+int shm_open(const char *name, int oflag);
+
+/* 删除名字，已经打开或映射的进程仍可使用，全部关闭和解除映射后释放 */
+int shm_unlink(const char *name);
+
+/* 设置共享内存对象的大小，缩小后超出部分在新的映射中不可访问 */
+int ftruncate(int fd, __off_t length);
@@ -5,6 +5,8 @@
 typedef __PTRDIFF_TYPE__ ptrdiff_t;
 typedef __WCHAR_TYPE__ wchar_t;
 
+#define NULL ((void *)0)
+
 #define offsetof(type, member) __builtin_offsetof(type, member)
 
 typedef __builtin_va_list va_list;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "stddef.h"
+#include "thread.h"
 
 #ifdef DEBUG_LOG
 #define Log(format, ...)                                                       \
@@ -10,4 +11,61 @@
 #define Log(format, ...) ;
 #endif
 
-int printf(const char *, ...);
\ No newline at end of file
+#define EOF (-1)
+#define BUFSIZ 1024
+
+/* setvbuf 的缓冲模式 */
+#define _IOFBF 0 // 缓冲区满时写出
+#define _IOLBF 1 // 遇到换行或缓冲区满时写出
+#define _IONBF 2 // 不缓冲
+
+// 带缓冲的流：stdin、stdout 对应串口，fopen 打开的对应 SFS 文件。
+// 缓冲区在第一次读写时才用 malloc 分配，读写的数据攒满一个缓冲区才陷入内核一次。
+// 同一时刻缓冲区只用于一个方向，切换读写方向或 fseek 时先写出或丢弃。
+// 同一进程的线程共享所有流，每个流有一把锁，库函数在锁内读写缓冲区。
+typedef struct FILE {
+  int fd;
+  int flags;          // __F_* 标志
+  int mode;           // 缓冲模式
+  char *buf;
+  size_t size;        // 缓冲区大小
+  size_t pos;         // 读：下一个要读的位置；写：已缓冲的字节数
+  size_t len;         // 读：缓冲区中有效数据的长度
+  struct FILE *next;  // 所有打开的流，fflush(NULL) 时遍历
+  mutex_t lock;
+} FILE;
+
+extern FILE *stdin;
+extern FILE *stdout;
+
+FILE *fopen(const char *path, const char *mode);
+int fclose(FILE *f);
+
+/* 把写缓冲中的数据写出，f 为 NULL 时写出所有流 */
+int fflush(FILE *f);
+
+/* 在第一次读写之前设置缓冲区，buf 为 NULL 时由库分配 size 字节 */
+int setvbuf(FILE *f, char *buf, int mode, size_t size);
+
+size_t fread(void *ptr, size_t size, size_t nmemb, FILE *f);
+size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *f);
+
+/* whence 为 fs.h 中的 SEEK_*，成功返回 0 */
+int fseek(FILE *f, int off, int whence);
+
+int fgetc(FILE *f);
+int fputc(int c, FILE *f);
+
+/* 给流加锁，把多次读写合成一次不被其他线程打断的操作，加锁期间只能用 *_unlocked */
+void flockfile(FILE *f);
+void funlockfile(FILE *f);
+
+/* 同 fputc，但调用者已经持有 f 的锁 */
+int fputc_unlocked(int c, FILE *f);
+int fputs(const char *s, FILE *f);
+int feof(FILE *f);
+int ferror(FILE *f);
+
+int printf(const char *, ...);
+int fprintf(FILE *f, const char *, ...);
+int vfprintf(FILE *f, const char *, va_list vl);
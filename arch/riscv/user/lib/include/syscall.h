@@ -1,14 +1,26 @@
 #pragma once
 
+#define SYS_DUP2 24
+#define SYS_FTRUNCATE 46
+#define SYS_PIPE 59
 #define SYS_EXIT 60
 #define SYS_READ 63
 #define SYS_WRITE 64
+#define SYS_VMSPLICE 75
+#define SYS_FUTEX 98
+#define SYS_NANOSLEEP 101
+#define SYS_SCHED_SETSCHEDULER 119
 #define SYS_GETPID 172
+#define SYS_GETTID 178
 #define SYS_EXEC 191
+#define SYS_BRK 214
 #define SYS_MUNMAP 215
 #define SYS_FORK 220
 #define SYS_MMAP 222
+#define SYS_MADVISE 233
 #define SYS_WAIT 247
+#define SYS_IO_URING_SETUP 425
+#define SYS_IO_URING_ENTER 426
 
 #define SFS_OPEN      1001
 #define SFS_CLOSE     1002
@@ -17,6 +29,9 @@
 #define SFS_WRITE     1005
 #define SFS_GET_FILES 1006
 
+#define SYS_SHM_OPEN   1007
+#define SYS_SHM_UNLINK 1008
+
 #include "types.h"
 
 struct ret_info {
@@ -0,0 +1,51 @@
+#pragma once
+#include "types.h"
+
+/* clone 的标志，与内核 task_manager.h 中的定义一致 */
+#define CLONE_VM 0x100
+#define CLONE_FILES 0x400
+
+/* 创建线程运行 fn(arg)，与调用者共享地址空间和 fd 表，返回线程 id，失败返回 -1。
+ * stack 是新线程用户栈的栈顶（16 字节对齐），由调用者分配，线程结束之前不能释放；
+ * 栈顶的一小块用作线程的 malloc 缓存（见 malloc.h）。
+ * fn 返回后线程以它的返回值退出。线程是调用者的子进程，由调用者用 thread_join 回收 */
+int thread_create(int (*fn)(void *), void *arg, void *stack);
+
+/* 等待线程 tid 退出并回收，返回它的退出码，出错返回 -1 */
+int thread_join(int tid);
+
+/* 返回当前线程的 id，getpid 返回的是所属进程的 pid */
+int gettid(void);
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+/* *uaddr 等于 val 时睡眠直到被 futex_wake 唤醒，返回 0；不相等时立即返回 -1 */
+int futex_wait(volatile uint32_t *uaddr, uint32_t val);
+
+/* 唤醒最多 n 个在 uaddr 上等待的线程，返回唤醒的个数 */
+int futex_wake(volatile uint32_t *uaddr, uint32_t n);
+
+// 互斥锁和条件变量只在竞争时才陷入内核。
+// mutex 的 state：0 未加锁，1 已加锁且没有等待者，2 已加锁且可能有等待者。
+// 也可以放在共享内存（shm.h）中，供多个进程使用。
+
+typedef struct {
+  volatile uint32_t state;
+} mutex_t;
+
+/* cond 的 seq 在每次 signal、broadcast 时加一，等待者在 seq 上睡眠 */
+typedef struct {
+  volatile uint32_t seq;
+} cond_t;
+
+#define MUTEX_INITIALIZER {0}
+#define COND_INITIALIZER {0}
+
+void mutex_lock(mutex_t *m);
+void mutex_unlock(mutex_t *m);
+
+/* 释放 m 并等待 signal 或 broadcast，返回前重新获得 m；可能虚假唤醒，调用者要重新检查条件 */
+void cond_wait(cond_t *c, mutex_t *m);
+void cond_signal(cond_t *c);
+void cond_broadcast(cond_t *c);
@@ -0,0 +1,18 @@
+#pragma once
+#include "types.h"
+
+struct timespec {
+  long tv_sec;
+  long tv_nsec;
+};
+
+#define CLOCK_MONOTONIC 1
+
+/* 读取时钟，目前只支持 CLOCK_MONOTONIC（启动以来的时间）。通过 vvar 页计算，不陷入内核 */
+int clock_gettime(int clk, struct timespec *tp);
+
+/* 睡眠 *req 指定的时长，成功返回 0，参数不合法返回 -1。rem 仅为兼容保留，不会被写入 */
+int nanosleep(const struct timespec *req, struct timespec *rem);
+
+/* 睡眠 usec 微秒 */
+int usleep(uint64_t usec);
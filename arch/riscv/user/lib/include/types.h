@@ -2,6 +2,7 @@ typedef unsigned int uint;
 typedef unsigned short ushort;
 typedef unsigned char uchar;
 typedef unsigned long uintptr_t;
+typedef long intptr_t;
 
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
@@ -0,0 +1,19 @@
+#pragma once
+#include "types.h"
+
+/* 内核映射到每个进程的只读 vvar 页，与内核 include/vdso.h 中的定义一致 */
+#define VVAR_ADDR 0x1004000
+
+struct vvar_data {
+  uint64_t timebase_freq;  // time CSR 的频率
+  uint64_t clock_base;     // 单调时钟零点对应的 time 值
+  long pid;
+  uint64_t nr_syscalls;    // 系统调用次数
+  uint64_t nr_page_faults; // 缺页次数
+  uint64_t nr_switches;    // 被切换出 CPU 的次数
+};
+
+/* 返回本进程的 vvar 页，计数器由内核随时更新 */
+static inline const volatile struct vvar_data *vdso_data(void) {
+  return (const volatile struct vvar_data *)VVAR_ADDR;
+}
@@ -1,7 +1,18 @@
 #include "getchar.h"
+#include "stdio.h"
 #include "syscall.h"
 
+long read(int fd, void *buf, size_t count) {
+  struct ret_info ret = u_syscall(SYS_READ, fd, (uint64_t)buf, count, 0, 0, 0);
+  return (long)ret.a0;
+}
+
+long write(int fd, const void *buf, size_t count) {
+  struct ret_info ret = u_syscall(SYS_WRITE, fd, (uint64_t)buf, count, 0, 0, 0);
+  return (long)ret.a0;
+}
+
 int getchar() {
-  struct ret_info ret = u_syscall(SYS_READ, 0, 0, 0, 0, 0, 0);
-  return (int)ret.a0;
-}
\ No newline at end of file
+  // 经过 stdin 的缓冲区，一次 read 取走所有已到达的输入
+  return fgetc(stdin);
+}
@@ -0,0 +1,81 @@
+#include "io_uring.h"
+#include "syscall.h"
+
+int io_uring_queue_init(void *addr, uint32_t entries, uint32_t flags,
+                        struct io_uring *ring) {
+  struct ret_info ret = u_syscall(SYS_IO_URING_SETUP, (uint64_t)addr, entries, flags, 0, 0, 0);
+  if ((long)ret.a0 < 0) {
+    return -1;
+  }
+  ring->rings = (struct io_rings *)addr;
+  ring->sqes = (struct io_uring_sqe *)((char *)addr + ring->rings->sq_off);
+  ring->cqes = (struct io_uring_cqe *)((char *)addr + ring->rings->cq_off);
+  ring->sqe_tail = ring->rings->sq_tail;
+  return 0;
+}
+
+struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring) {
+  struct io_rings *rings = ring->rings;
+  uint32_t head = __atomic_load_n(&rings->sq_head, __ATOMIC_ACQUIRE);
+  if (ring->sqe_tail - head >= rings->sq_entries) {
+    return 0;
+  }
+  struct io_uring_sqe *sqe = &ring->sqes[ring->sqe_tail & rings->sq_mask];
+  ring->sqe_tail++;
+  sqe->user_data = 0;
+  return sqe;
+}
+
+int io_uring_submit(struct io_uring *ring) {
+  struct io_rings *rings = ring->rings;
+  // 推进 sq_tail 之后，已填好的 SQE 对内核可见
+  __atomic_store_n(&rings->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+  uint32_t pending = ring->sqe_tail - __atomic_load_n(&rings->sq_head, __ATOMIC_ACQUIRE);
+  // SQPOLL 模式下由内核在时钟中断中取走，不需要陷入
+  if (pending == 0 || (rings->flags & IORING_SETUP_SQPOLL)) {
+    return pending;
+  }
+  struct ret_info ret = u_syscall(SYS_IO_URING_ENTER, pending, 0, 0, 0, 0, 0);
+  return ret.a0;
+}
+
+struct io_uring_cqe *io_uring_peek_cqe(struct io_uring *ring) {
+  struct io_rings *rings = ring->rings;
+  uint32_t tail = __atomic_load_n(&rings->cq_tail, __ATOMIC_ACQUIRE);
+  if (rings->cq_head == tail) {
+    return 0;
+  }
+  return &ring->cqes[rings->cq_head & rings->cq_mask];
+}
+
+void io_uring_cqe_seen(struct io_uring *ring) {
+  __atomic_store_n(&ring->rings->cq_head, ring->rings->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+static void io_uring_prep(struct io_uring_sqe *sqe, uint64_t opcode,
+                          uint64_t arg0, uint64_t arg1, uint64_t arg2) {
+  sqe->opcode = opcode;
+  sqe->args[0] = arg0;
+  sqe->args[1] = arg1;
+  sqe->args[2] = arg2;
+}
+
+void io_uring_prep_open(struct io_uring_sqe *sqe, const char *path, uint32_t flags) {
+  io_uring_prep(sqe, SFS_OPEN, (uint64_t)path, flags, 0);
+}
+
+void io_uring_prep_close(struct io_uring_sqe *sqe, int fd) {
+  io_uring_prep(sqe, SFS_CLOSE, fd, 0, 0);
+}
+
+void io_uring_prep_seek(struct io_uring_sqe *sqe, int fd, int off, int fromwhere) {
+  io_uring_prep(sqe, SFS_SEEK, fd, off, fromwhere);
+}
+
+void io_uring_prep_read(struct io_uring_sqe *sqe, int fd, char *buf, uint32_t len) {
+  io_uring_prep(sqe, SFS_READ, fd, (uint64_t)buf, len);
+}
+
+void io_uring_prep_write(struct io_uring_sqe *sqe, int fd, char *buf, uint32_t len) {
+  io_uring_prep(sqe, SFS_WRITE, fd, (uint64_t)buf, len);
+}
@@ -0,0 +1,200 @@
+#include "malloc.h"
+#include "mm.h"
+#include "thread.h"
+
+// 按大小分级的用户态内存分配器：
+// 小对象 (<= 2048 字节) 按 16, 32, ..., 2048 分为 8 级，每级一个空闲链表，
+// 链表为空时一次 sbrk 一批 (REFILL_SIZE) 并切成同级对象；
+// 大对象直接向 sbrk 申请，释放后放入大块空闲链表按首次适配复用。
+// 因此大多数 malloc/free 不会产生系统调用。
+// 共享的空闲链表由 malloc_lock 保护。小对象先走线程自己的缓存（struct malloc_tcache），
+// 缓存空了一次从共享链表取 TCACHE_BATCH 个，攒多了再还回去一批，多数操作不加锁。
+
+#define NR_CLASSES MALLOC_NR_CLASSES
+#define MIN_CLASS_SHIFT 4
+#define MAX_SMALL_SIZE 2048
+#define REFILL_SIZE (4 * 4096)
+#define ALIGN 16
+#define LARGE_CLASS NR_CLASSES
+#define TCACHE_BATCH 16
+
+// 每个对象前的头部，保持 16 字节对齐
+struct chunk {
+  size_t size;  // 对象可用大小
+  size_t cls;   // 所属级别，LARGE_CLASS 表示大对象
+};
+
+struct free_obj {
+  struct free_obj *next;
+};
+
+static struct free_obj *free_lists[NR_CLASSES];
+static struct free_obj *large_list;
+static mutex_t malloc_lock = MUTEX_INITIALIZER;
+static struct malloc_tcache main_tcache;
+
+static inline struct malloc_tcache *this_tcache(void) {
+  struct malloc_tcache *tc;
+  asm volatile("mv %0, tp" : "=r"(tc));
+  return tc ? tc : &main_tcache;
+}
+
+static inline int size_to_class(size_t size) {
+  int cls = 0;
+  size_t cap = 1UL << MIN_CLASS_SHIFT;
+  while (cap < size) {
+    cap <<= 1;
+    cls++;
+  }
+  return cls;
+}
+
+static inline size_t class_to_size(int cls) {
+  return 1UL << (cls + MIN_CLASS_SHIFT);
+}
+
+static int refill(int cls) {
+  size_t obj = sizeof(struct chunk) + class_to_size(cls);
+  char *base = sbrk(REFILL_SIZE);
+  if (base == (void *)-1)
+    return -1;
+  for (char *p = base; p + obj <= base + REFILL_SIZE; p += obj) {
+    struct chunk *c = (struct chunk *)p;
+    struct free_obj *f = (struct free_obj *)(c + 1);
+    c->size = class_to_size(cls);
+    c->cls = cls;
+    f->next = free_lists[cls];
+    free_lists[cls] = f;
+  }
+  return 0;
+}
+
+static void *malloc_large(size_t size) {
+  size = (size + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+
+  struct free_obj **link = &large_list;
+  while (*link) {
+    struct chunk *c = (struct chunk *)(*link) - 1;
+    if (c->size >= size) {
+      struct free_obj *f = *link;
+      *link = f->next;
+      return f;
+    }
+    link = &(*link)->next;
+  }
+
+  struct chunk *c = sbrk(sizeof(struct chunk) + size);
+  if (c == (void *)-1)
+    return 0;
+  c->size = size;
+  c->cls = LARGE_CLASS;
+  return c + 1;
+}
+
+// 从共享链表取最多 TCACHE_BATCH 个对象放进线程缓存
+static void tcache_fill(struct malloc_tcache *tc, int cls) {
+  mutex_lock(&malloc_lock);
+  if (free_lists[cls] || !refill(cls)) {
+    while (free_lists[cls] && tc->counts[cls] < TCACHE_BATCH) {
+      struct free_obj *f = free_lists[cls];
+      free_lists[cls] = f->next;
+      f->next = tc->lists[cls];
+      tc->lists[cls] = f;
+      tc->counts[cls]++;
+    }
+  }
+  mutex_unlock(&malloc_lock);
+}
+
+// 把线程缓存中的 n 个对象还给共享链表
+static void tcache_drain(struct malloc_tcache *tc, int cls, uint32_t n) {
+  mutex_lock(&malloc_lock);
+  while (n-- && tc->lists[cls]) {
+    struct free_obj *f = tc->lists[cls];
+    tc->lists[cls] = f->next;
+    tc->counts[cls]--;
+    f->next = free_lists[cls];
+    free_lists[cls] = f;
+  }
+  mutex_unlock(&malloc_lock);
+}
+
+void *malloc(size_t size) {
+  if (size == 0)
+    return 0;
+  if (size > MAX_SMALL_SIZE) {
+    mutex_lock(&malloc_lock);
+    void *p = malloc_large(size);
+    mutex_unlock(&malloc_lock);
+    return p;
+  }
+
+  struct malloc_tcache *tc = this_tcache();
+  int cls = size_to_class(size);
+  if (!tc->lists[cls]) {
+    tcache_fill(tc, cls);
+    if (!tc->lists[cls])
+      return 0;
+  }
+  struct free_obj *f = tc->lists[cls];
+  tc->lists[cls] = f->next;
+  tc->counts[cls]--;
+  return f;
+}
+
+void free(void *ptr) {
+  if (!ptr)
+    return;
+  struct chunk *c = (struct chunk *)ptr - 1;
+  struct free_obj *f = ptr;
+  if (c->cls == LARGE_CLASS) {
+    mutex_lock(&malloc_lock);
+    f->next = large_list;
+    large_list = f;
+    mutex_unlock(&malloc_lock);
+    return;
+  }
+  // 对象可能是别的线程分配的，放进当前线程的缓存即可
+  struct malloc_tcache *tc = this_tcache();
+  f->next = tc->lists[c->cls];
+  tc->lists[c->cls] = f;
+  if (++tc->counts[c->cls] > 2 * TCACHE_BATCH)
+    tcache_drain(tc, c->cls, TCACHE_BATCH);
+}
+
+void malloc_thread_exit(void) {
+  struct malloc_tcache *tc = this_tcache();
+  for (int cls = 0; cls < NR_CLASSES; cls++)
+    tcache_drain(tc, cls, tc->counts[cls]);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  size_t total = nmemb * size;
+  if (size && total / size != nmemb)
+    return 0;
+  char *p = malloc(total);
+  if (p) {
+    for (size_t i = 0; i < total; i++)
+      p[i] = 0;
+  }
+  return p;
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (!ptr)
+    return malloc(size);
+  if (size == 0) {
+    free(ptr);
+    return 0;
+  }
+  struct chunk *c = (struct chunk *)ptr - 1;
+  if (c->size >= size)
+    return ptr;
+  char *n = malloc(size);
+  if (!n)
+    return 0;
+  for (size_t i = 0; i < c->size; i++)
+    n[i] = ((char *)ptr)[i];
+  free(ptr);
+  return n;
+}
@@ -15,4 +15,29 @@ int munmap(void *__addr, size_t __len) {
   int ret;
   ret = u_syscall(SYS_MUNMAP, (uint64_t)__addr, (uint64_t)__len, 0, 0, 0, 0).a0;
   return ret;
+}
+
+int madvise(void *__addr, size_t __len, int __advice) {
+  int ret;
+  ret = u_syscall(SYS_MADVISE, (uint64_t)__addr, (uint64_t)__len,
+                  (uint64_t)__advice, 0, 0, 0)
+            .a0;
+  return ret;
+}
+
+int brk(void *__addr) {
+  uint64_t cur;
+  cur = u_syscall(SYS_BRK, (uint64_t)__addr, 0, 0, 0, 0, 0).a0;
+  return cur == (uint64_t)__addr ? 0 : -1;
+}
+
+void *sbrk(intptr_t __increment) {
+  uint64_t old, cur;
+  old = u_syscall(SYS_BRK, 0, 0, 0, 0, 0, 0).a0;
+  if (__increment == 0)
+    return (void *)old;
+  cur = u_syscall(SYS_BRK, old + __increment, 0, 0, 0, 0, 0).a0;
+  if (cur != old + __increment)
+    return (void *)-1;
+  return (void *)old;
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "pipe.h"
+#include "syscall.h"
+
+int pipe(int fds[2]) {
+  struct ret_info ret = u_syscall(SYS_PIPE, (uint64_t)fds, 0, 0, 0, 0, 0);
+  return (int)ret.a0;
+}
+
+int dup2(int oldfd, int newfd) {
+  struct ret_info ret = u_syscall(SYS_DUP2, oldfd, newfd, 0, 0, 0, 0);
+  return (int)ret.a0;
+}
+
+int close(int fd) {
+  struct ret_info ret = u_syscall(SFS_CLOSE, fd, 0, 0, 0, 0, 0);
+  return (int)ret.a0;
+}
+
+long vmsplice(int fd, void *buf, size_t len) {
+  struct ret_info ret = u_syscall(SYS_VMSPLICE, fd, (uint64_t)buf, len, 0, 0, 0);
+  return (long)ret.a0;
+}
@@ -1,15 +1,8 @@
 #include "stdio.h"
-#include "syscall.h"
 
-int tail = 0;
-char buffer[1000] = {[0 ... 999] = 0};
-
-static inline int putchar(int c) {
-  buffer[tail++] = (char)c;
-  return 0;
-}
-
-static int vprintfmt(int (*putch)(int), const char *fmt, va_list vl) {
+// 格式化输出逐字符写入 f 的缓冲区，何时真正写出由 f 的缓冲模式决定。
+// 调用者持有 f 的锁，一次 printf 的输出不会与其他线程的输出交错
+static int vprintfmt(FILE *f, const char *fmt, va_list vl) {
   int in_format = 0, longarg = 0;
   size_t pos = 0;
 
@@ -28,7 +21,7 @@ static int vprintfmt(int (*putch)(int), const char *fmt, va_list vl) {
         for (int halfbyte = hexdigits; halfbyte >= 0; halfbyte--) {
           int hex = (num >> (4 * halfbyte)) & 0xF;
           char hexchar = (hex < 10 ? '0' + hex : 'a' + hex - 10);
-          putch(hexchar);
+          fputc_unlocked(hexchar, f);
           pos++;
         }
         longarg = 0;
@@ -40,7 +33,7 @@ static int vprintfmt(int (*putch)(int), const char *fmt, va_list vl) {
         long num = longarg ? va_arg(vl, long) : va_arg(vl, int);
         if (num < 0) {
           num = -num;
-          putch('-');
+          fputc_unlocked('-', f);
           pos++;
         }
         int bits = 0;
@@ -54,7 +47,7 @@ static int vprintfmt(int (*putch)(int), const char *fmt, va_list vl) {
           bits++;
 
         for (int i = bits - 1; i >= 0; i--) {
-          putch(decchar[i]);
+          fputc_unlocked(decchar[i], f);
         }
         pos += bits + 1;
         longarg = 0;
@@ -75,7 +68,7 @@ static int vprintfmt(int (*putch)(int), const char *fmt, va_list vl) {
           bits++;
 
         for (int i = bits - 1; i >= 0; i--) {
-          putch(decchar[i]);
+          fputc_unlocked(decchar[i], f);
         }
         pos += bits - 1;
         longarg = 0;
@@ -86,7 +79,7 @@ static int vprintfmt(int (*putch)(int), const char *fmt, va_list vl) {
       case 's': {
         const char *str = va_arg(vl, const char *);
         while (*str) {
-          putch(*str);
+          fputc_unlocked(*str, f);
           pos++;
           str++;
         }
@@ -97,7 +90,7 @@ static int vprintfmt(int (*putch)(int), const char *fmt, va_list vl) {
 
       case 'c': {
         char ch = (char)va_arg(vl, int);
-        putch(ch);
+        fputc_unlocked(ch, f);
         pos++;
         longarg = 0;
         in_format = 0;
@@ -109,26 +102,35 @@ static int vprintfmt(int (*putch)(int), const char *fmt, va_list vl) {
     } else if (*fmt == '%') {
       in_format = 1;
     } else {
-      putch(*fmt);
+      fputc_unlocked(*fmt, f);
       pos++;
     }
   }
 
-  long syscall_ret, fd = 1;
-  buffer[tail++] = '\0';
-  // 完成系统调用，将 buffer 中的内容写入文件描述符 fd 中，返回输出字符串的大小
+  return pos;
+}
 
-  syscall_ret = u_syscall(SYS_WRITE, fd, (uint64_t)buffer, tail, 0, 0, 0).a0;
+int vfprintf(FILE *f, const char *fmt, va_list vl) {
+  flockfile(f);
+  int res = vprintfmt(f, fmt, vl);
+  funlockfile(f);
+  return res;
+}
 
-  return syscall_ret;
+int fprintf(FILE *f, const char *s, ...) {
+  int res = 0;
+  va_list vl;
+  va_start(vl, s);
+  res = vfprintf(f, s, vl);
+  va_end(vl);
+  return res;
 }
 
 int printf(const char *s, ...) {
   int res = 0;
   va_list vl;
   va_start(vl, s);
-  tail = 0;
-  res = vprintfmt(putchar, s, vl);
+  res = vfprintf(stdout, s, vl);
   va_end(vl);
   return res;
-}
\ No newline at end of file
+}
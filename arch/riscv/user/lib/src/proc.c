@@ -1,19 +1,33 @@
 #include "proc.h"
+#include "stdio.h"
 #include "syscall.h"
 
 int fork() {
+  // 否则缓冲区中还没写出的数据会在父子进程中各写出一次
+  fflush(NULL);
   struct ret_info ret = u_syscall(SYS_FORK, 0, 0, 0, 0, 0, 0);
   return ret.a0;
 }
 
 void wait(int pid) {
-  u_syscall(SYS_WAIT, pid, 0, 0, 0, 0, 0);
+  waitpid(pid, 0);
+}
+
+int waitpid(int pid, int *status) {
+  struct ret_info ret = u_syscall(SYS_WAIT, pid, (uint64_t)status, 0, 0, 0, 0);
+  return ret.a0;
 }
 
 void exit(int ret) {
+  fflush(NULL);
   u_syscall(SYS_EXIT, ret, 0, 0, 0, 0, 0);
 }
 
 void exec(const char * path) {
   u_syscall(SYS_EXEC, (uint64_t)path, 0, 0, 0, 0, 0);
-}
\ No newline at end of file
+}
+
+int sched_setscheduler(int pid, int policy, int param) {
+  struct ret_info ret = u_syscall(SYS_SCHED_SETSCHEDULER, pid, policy, param, 0, 0, 0);
+  return ret.a0;
+}
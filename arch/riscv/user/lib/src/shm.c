@@ -0,0 +1,17 @@
+#include "shm.h"
+#include "syscall.h"
+
+int shm_open(const char *name, int oflag) {
+  struct ret_info ret = u_syscall(SYS_SHM_OPEN, (uint64_t)name, oflag, 0, 0, 0, 0);
+  return (int)ret.a0;
+}
+
+int shm_unlink(const char *name) {
+  struct ret_info ret = u_syscall(SYS_SHM_UNLINK, (uint64_t)name, 0, 0, 0, 0, 0);
+  return (int)ret.a0;
+}
+
+int ftruncate(int fd, __off_t length) {
+  struct ret_info ret = u_syscall(SYS_FTRUNCATE, fd, length, 0, 0, 0, 0);
+  return (int)ret.a0;
+}
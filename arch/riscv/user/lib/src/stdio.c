@@ -0,0 +1,373 @@
+#include "stdio.h"
+#include "fs.h"
+#include "getchar.h"
+#include "malloc.h"
+#include "syscall.h"
+
+#define __F_READ 0x1    // 可读
+#define __F_WRITE 0x2   // 可写
+#define __F_CONSOLE 0x4 // 串口，fd 是 SYS_READ/SYS_WRITE 的 fd，不是 SFS 的
+#define __F_RBUF 0x8    // 缓冲区中是读入的数据
+#define __F_EOF 0x10
+#define __F_ERR 0x20
+#define __F_MYBUF 0x40  // 缓冲区由库分配，fclose 时释放
+
+static FILE __stdin = {.fd = 0, .flags = __F_READ | __F_CONSOLE, .mode = _IOLBF,
+                       .lock = MUTEX_INITIALIZER};
+static FILE __stdout = {.fd = 1, .flags = __F_WRITE | __F_CONSOLE, .mode = _IOLBF,
+                        .next = &__stdin, .lock = MUTEX_INITIALIZER};
+
+FILE *stdin = &__stdin;
+FILE *stdout = &__stdout;
+
+// 保护 file_list。需要同时持有时先拿 list_lock 再拿流的锁
+static FILE *file_list = &__stdout;
+static mutex_t list_lock = MUTEX_INITIALIZER;
+
+// 以 __ 开头的函数调用者持有 f->lock
+static int __fflush(FILE *f);
+
+static long __read(FILE *f, char *buf, size_t len) {
+  if (f->flags & __F_CONSOLE) {
+    // 等待输入之前先把提示符之类的行缓冲输出写出去，stdin 的锁在 stdout 的锁之前
+    fflush(stdout);
+    return read(f->fd, buf, len);
+  }
+  return sfs_read(f->fd, buf, len);
+}
+
+static int __write_all(FILE *f, const char *buf, size_t len) {
+  while (len) {
+    long n;
+    if (f->flags & __F_CONSOLE) {
+      n = u_syscall(SYS_WRITE, f->fd, (uint64_t)buf, len, 0, 0, 0).a0;
+    } else {
+      n = sfs_write(f->fd, (char *)buf, len);
+    }
+    if (n <= 0) {
+      f->flags |= __F_ERR;
+      return EOF;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+// 第一次读写时分配缓冲区，分配失败就退化为不缓冲
+static void __alloc_buf(FILE *f) {
+  if (f->buf || f->mode == _IONBF) {
+    return;
+  }
+  if (f->size == 0) {
+    f->size = BUFSIZ;
+  }
+  f->buf = malloc(f->size);
+  if (f->buf == NULL) {
+    f->mode = _IONBF;
+    return;
+  }
+  f->flags |= __F_MYBUF;
+}
+
+// 丢弃读缓冲，SFS 文件的位置退回到调用者实际读到的地方
+static void __drop_rbuf(FILE *f) {
+  if (!(f->flags & __F_RBUF)) {
+    return;
+  }
+  size_t unread = f->len - f->pos;
+  f->flags &= ~__F_RBUF;
+  f->pos = f->len = 0;
+  if (unread && !(f->flags & __F_CONSOLE)) {
+    sfs_seek(f->fd, -(int)unread, SEEK_CUR);
+  }
+}
+
+FILE *fopen(const char *path, const char *mode) {
+  int rw, append = 0;
+  switch (mode[0]) {
+  case 'r':
+    rw = __F_READ;
+    break;
+  case 'w':
+    // SFS 不支持截断，已有的内容会被覆盖但不会被清空
+    rw = __F_WRITE;
+    break;
+  case 'a':
+    rw = __F_WRITE;
+    append = 1;
+    break;
+  default:
+    return NULL;
+  }
+  for (const char *m = mode + 1; *m; m++) {
+    if (*m == '+') {
+      rw = __F_READ | __F_WRITE;
+    }
+  }
+
+  int fd = sfs_open(path, ((rw & __F_READ) ? SFS_FLAG_READ : 0) |
+                              ((rw & __F_WRITE) ? SFS_FLAG_WRITE : 0));
+  if (fd < 0) {
+    return NULL;
+  }
+  if (append) {
+    sfs_seek(fd, 0, SEEK_END);
+  }
+
+  FILE *f = malloc(sizeof(FILE));
+  if (f == NULL) {
+    sfs_close(fd);
+    return NULL;
+  }
+  f->fd = fd;
+  f->flags = rw;
+  f->mode = _IOFBF;
+  f->buf = NULL;
+  f->size = 0;
+  f->pos = f->len = 0;
+  f->lock = (mutex_t)MUTEX_INITIALIZER;
+  mutex_lock(&list_lock);
+  f->next = file_list;
+  file_list = f;
+  mutex_unlock(&list_lock);
+  return f;
+}
+
+int fclose(FILE *f) {
+  int ret = fflush(f);
+  if (f->flags & __F_CONSOLE) {
+    return ret;
+  }
+  mutex_lock(&list_lock);
+  for (FILE **p = &file_list; *p; p = &(*p)->next) {
+    if (*p == f) {
+      *p = f->next;
+      break;
+    }
+  }
+  mutex_unlock(&list_lock);
+  if (sfs_close(f->fd) < 0) {
+    ret = EOF;
+  }
+  if (f->flags & __F_MYBUF) {
+    free(f->buf);
+  }
+  free(f);
+  return ret;
+}
+
+int fflush(FILE *f) {
+  int ret = 0;
+  if (f == NULL) {
+    mutex_lock(&list_lock);
+    // 只读的流没有要写出的数据，跳过它们，不必等在 stdin 上读的线程
+    for (FILE *p = file_list; p; p = p->next) {
+      if ((p->flags & __F_WRITE) && fflush(p)) {
+        ret = EOF;
+      }
+    }
+    mutex_unlock(&list_lock);
+    return ret;
+  }
+  mutex_lock(&f->lock);
+  ret = __fflush(f);
+  mutex_unlock(&f->lock);
+  return ret;
+}
+
+static int __fflush(FILE *f) {
+  if ((f->flags & __F_RBUF) || f->pos == 0) {
+    return 0;
+  }
+  size_t n = f->pos;
+  f->pos = 0;
+  return __write_all(f, f->buf, n);
+}
+
+int setvbuf(FILE *f, char *buf, int mode, size_t size) {
+  int ret = 0;
+  mutex_lock(&f->lock);
+  // 只能在第一次读写之前设置
+  if (f->buf || mode < _IOFBF || mode > _IONBF) {
+    ret = EOF;
+  } else {
+    f->mode = mode;
+    if (buf && size) {
+      f->buf = buf;
+      f->size = size;
+    } else if (size) {
+      f->size = size;
+    }
+  }
+  mutex_unlock(&f->lock);
+  return ret;
+}
+
+static size_t __fread(void *ptr, size_t size, size_t nmemb, FILE *f) {
+  size_t total = size * nmemb, got = 0;
+  char *p = ptr;
+  if (!(f->flags & __F_READ) || total == 0) {
+    return 0;
+  }
+  if (!(f->flags & __F_RBUF)) {
+    if (__fflush(f)) {
+      return 0;
+    }
+    f->flags |= __F_RBUF;
+    f->pos = f->len = 0;
+  }
+  __alloc_buf(f);
+
+  while (got < total) {
+    if (f->pos < f->len) {
+      while (got < total && f->pos < f->len) {
+        p[got++] = f->buf[f->pos++];
+      }
+      continue;
+    }
+    // 缓冲区已读完：剩下的不比缓冲区小就直接读到调用者的内存里
+    long n;
+    if (f->mode == _IONBF || total - got >= f->size) {
+      n = __read(f, p + got, total - got);
+      if (n > 0) {
+        got += n;
+      }
+    } else {
+      n = __read(f, f->buf, f->size);
+      f->pos = 0;
+      f->len = n > 0 ? n : 0;
+    }
+    if (n == 0) {
+      f->flags |= __F_EOF;
+      break;
+    }
+    if (n < 0) {
+      f->flags |= __F_ERR;
+      break;
+    }
+  }
+  return got / size;
+}
+
+size_t fread(void *ptr, size_t size, size_t nmemb, FILE *f) {
+  mutex_lock(&f->lock);
+  size_t n = __fread(ptr, size, nmemb, f);
+  mutex_unlock(&f->lock);
+  return n;
+}
+
+static size_t __fwrite(const void *ptr, size_t size, size_t nmemb, FILE *f) {
+  size_t total = size * nmemb;
+  const char *p = ptr;
+  if (!(f->flags & __F_WRITE) || total == 0) {
+    return 0;
+  }
+  __drop_rbuf(f);
+  __alloc_buf(f);
+
+  if (f->mode == _IONBF) {
+    return __write_all(f, p, total) ? 0 : nmemb;
+  }
+  // 放不下时先写出已缓冲的数据，不比缓冲区小的直接写出，不再拷贝
+  if (f->pos + total > f->size) {
+    if (__fflush(f)) {
+      return 0;
+    }
+    if (total >= f->size) {
+      return __write_all(f, p, total) ? 0 : nmemb;
+    }
+  }
+
+  int newline = 0;
+  for (size_t i = 0; i < total; i++) {
+    f->buf[f->pos++] = p[i];
+    newline |= p[i] == '\n';
+  }
+  if (f->pos == f->size || (newline && f->mode == _IOLBF)) {
+    if (__fflush(f)) {
+      return 0;
+    }
+  }
+  return nmemb;
+}
+
+size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *f) {
+  mutex_lock(&f->lock);
+  size_t n = __fwrite(ptr, size, nmemb, f);
+  mutex_unlock(&f->lock);
+  return n;
+}
+
+int fseek(FILE *f, int off, int whence) {
+  if (f->flags & __F_CONSOLE) {
+    return EOF;
+  }
+  int ret = EOF;
+  mutex_lock(&f->lock);
+  if (__fflush(f) == 0) {
+    __drop_rbuf(f);
+    f->flags &= ~__F_EOF;
+    ret = sfs_seek(f->fd, off, whence) < 0 ? EOF : 0;
+  }
+  mutex_unlock(&f->lock);
+  return ret;
+}
+
+int fgetc(FILE *f) {
+  int c;
+  mutex_lock(&f->lock);
+  if ((f->flags & __F_RBUF) && f->pos < f->len) {
+    c = (unsigned char)f->buf[f->pos++];
+  } else {
+    unsigned char ch;
+    c = __fread(&ch, 1, 1, f) == 1 ? ch : EOF;
+  }
+  mutex_unlock(&f->lock);
+  return c;
+}
+
+int fputc_unlocked(int c, FILE *f) {
+  // 最常见的情况：缓冲区已在写方向、还有空间
+  if (f->buf && !(f->flags & __F_RBUF) && (f->flags & __F_WRITE) &&
+      f->mode != _IONBF && f->pos + 1 < f->size) {
+    f->buf[f->pos++] = (char)c;
+    if (c == '\n' && f->mode == _IOLBF && __fflush(f)) {
+      return EOF;
+    }
+    return (unsigned char)c;
+  }
+  char ch = (char)c;
+  return __fwrite(&ch, 1, 1, f) == 1 ? (unsigned char)c : EOF;
+}
+
+int fputc(int c, FILE *f) {
+  mutex_lock(&f->lock);
+  c = fputc_unlocked(c, f);
+  mutex_unlock(&f->lock);
+  return c;
+}
+
+void flockfile(FILE *f) {
+  mutex_lock(&f->lock);
+}
+
+void funlockfile(FILE *f) {
+  mutex_unlock(&f->lock);
+}
+
+int fputs(const char *s, FILE *f) {
+  size_t len = 0;
+  while (s[len]) {
+    len++;
+  }
+  return fwrite(s, 1, len, f) == len ? 0 : EOF;
+}
+
+int feof(FILE *f) {
+  return (f->flags & __F_EOF) != 0;
+}
+
+int ferror(FILE *f) {
+  return (f->flags & __F_ERR) != 0;
+}
@@ -0,0 +1,110 @@
+#include "thread.h"
+#include "malloc.h"
+#include "proc.h"
+#include "syscall.h"
+
+// long __clone(uint64_t flags, void *stack, int (*fn)(void *), void *arg)
+// 新线程从 ecall 返回时 a0 为 0，其余寄存器与调用者相同，但 sp 已经是 stack，
+// 不能再返回到调用者的栈帧，所以直接在这里调用 __thread_start(fn, arg)，它不会返回。
+// stack 上方是线程的 malloc 缓存，让 tp 指向它
+asm(".globl __clone\n"
+    "__clone:\n"
+    "  li a7, 220\n"
+    "  ecall\n"
+    "  bnez a0, 1f\n"
+    "  mv tp, sp\n"
+    "  mv a0, a2\n"
+    "  mv a1, a3\n"
+    "  call __thread_start\n"
+    "1:\n"
+    "  ret\n");
+
+long __clone(uint64_t flags, void *stack, int (*fn)(void *), void *arg);
+
+void __thread_start(int (*fn)(void *), void *arg) {
+  int ret = fn(arg);
+  malloc_thread_exit();
+  exit(ret);
+}
+
+int thread_create(int (*fn)(void *), void *arg, void *stack) {
+  // 线程的 malloc 缓存放在栈顶，真正的栈从它下面开始，仍保持 16 字节对齐
+  uint64_t top = (uint64_t)stack;
+  uint64_t size = (sizeof(struct malloc_tcache) + 15) & ~15UL;
+  if (top % 16 || top < size) {
+    return -1;
+  }
+  struct malloc_tcache *tc = (struct malloc_tcache *)(top - size);
+  char *p = (char *)tc;
+  for (uint64_t i = 0; i < size; i++) {
+    p[i] = 0;
+  }
+  return (int)__clone(CLONE_VM | CLONE_FILES, tc, fn, arg);
+}
+
+int thread_join(int tid) {
+  int status;
+  if (waitpid(tid, &status) < 0) {
+    return -1;
+  }
+  return status;
+}
+
+int gettid(void) {
+  struct ret_info ret = u_syscall(SYS_GETTID, 0, 0, 0, 0, 0, 0);
+  return (int)ret.a0;
+}
+
+int futex_wait(volatile uint32_t *uaddr, uint32_t val) {
+  struct ret_info ret = u_syscall(SYS_FUTEX, (uint64_t)uaddr, FUTEX_WAIT, val, 0, 0, 0);
+  return (int)ret.a0;
+}
+
+int futex_wake(volatile uint32_t *uaddr, uint32_t n) {
+  struct ret_info ret = u_syscall(SYS_FUTEX, (uint64_t)uaddr, FUTEX_WAKE, n, 0, 0, 0);
+  return (int)ret.a0;
+}
+
+void mutex_lock(mutex_t *m) {
+  uint32_t c = 0;
+  if (__atomic_compare_exchange_n(&m->state, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    return;
+  }
+  // 有竞争：标记为有等待者，直到在解锁的瞬间抢到锁
+  if (c != 2) {
+    c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  }
+  while (c != 0) {
+    futex_wait(&m->state, 2);
+    c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  }
+}
+
+void mutex_unlock(mutex_t *m) {
+  // 从 1 变为 0 说明没有等待者，不需要陷入内核
+  if (__atomic_fetch_sub(&m->state, 1, __ATOMIC_RELEASE) != 1) {
+    __atomic_store_n(&m->state, 0, __ATOMIC_RELEASE);
+    futex_wake(&m->state, 1);
+  }
+}
+
+void cond_wait(cond_t *c, mutex_t *m) {
+  uint32_t seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
+  mutex_unlock(m);
+  // 解锁之后 seq 变了说明已经 signal 过，futex_wait 会立即返回
+  futex_wait(&c->seq, seq);
+  // 可能还有其他被唤醒的线程在等这把锁，按有等待者的状态加锁，解锁时才会唤醒它们
+  while (__atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE) != 0) {
+    futex_wait(&m->state, 2);
+  }
+}
+
+void cond_signal(cond_t *c) {
+  __atomic_add_fetch(&c->seq, 1, __ATOMIC_RELEASE);
+  futex_wake(&c->seq, 1);
+}
+
+void cond_broadcast(cond_t *c) {
+  __atomic_add_fetch(&c->seq, 1, __ATOMIC_RELEASE);
+  futex_wake(&c->seq, 0xffffffff);
+}
@@ -0,0 +1,28 @@
+#include "time.h"
+#include "syscall.h"
+#include "vdso.h"
+
+int clock_gettime(int clk, struct timespec *tp) {
+  if (clk != CLOCK_MONOTONIC) {
+    return -1;
+  }
+  const volatile struct vvar_data *vvar = vdso_data();
+  uint64_t now;
+  asm volatile("rdtime %0" : "=r"(now));
+  uint64_t delta = now - vvar->clock_base, freq = vvar->timebase_freq;
+  tp->tv_sec = delta / freq;
+  tp->tv_nsec = (delta % freq) * 1000000000UL / freq;
+  return 0;
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem) {
+  struct ret_info ret = u_syscall(SYS_NANOSLEEP, (uint64_t)req, (uint64_t)rem, 0, 0, 0, 0);
+  return ret.a0;
+}
+
+int usleep(uint64_t usec) {
+  struct timespec req;
+  req.tv_sec = usec / 1000000;
+  req.tv_nsec = (usec % 1000000) * 1000;
+  return nanosleep(&req, 0);
+}
@@ -7,7 +7,8 @@ int strcmp(const char *a, const char *b);
 int getchar_until_valid();
 
 int main() {
-  char program[][10] = {"hello", "read", "test", "fssh"};
+  char program[][10] = {"hello", "read", "test", "fssh", "pipe", "shm", "thread"};
+  const int nr_programs = sizeof(program) / sizeof(program[0]);
   char input[64];
   int n = 0, ch;
 
@@ -39,12 +40,12 @@ input_end:
 
     // exec user's instruction
     if (strcmp(input, "ls") == 0) {
-      for (int i = 0; i < 4; i++) {
+      for (int i = 0; i < nr_programs; i++) {
         printf("%s ", program[i]);
       }
       printf("\n");
     } else {
-      for (int i = 0; i < 4; i++) {
+      for (int i = 0; i < nr_programs; i++) {
         if (strcmp(input, program[i]) == 0) {
           int ret = fork();
           if (ret == 0) {
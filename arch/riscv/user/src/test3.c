@@ -1,4 +1,5 @@
 #include "fs.h"
+#include "io_uring.h"
 #include "stdio.h"
 
 int memcmp(const char *a, const char *b, int len) {
@@ -20,18 +21,37 @@ int main() {
       ;
   }
   printf("writing ...\n");
-  for (int i = 0; i < 4096; i++) {
-    int len = sfs_write(fd, "hello ", 6);
-    if (len != 6) {
+  // 通过 io_uring 批量写，每 64 次写入只陷入内核一次
+  struct io_uring ring;
+  if (io_uring_queue_init((void *)0x6000000, 64, 0, &ring) < 0) {
+    printf("io_uring setup failed!\n");
+    while (1)
+      ;
+  }
+  for (int i = 0; i < 4096; i += 64) {
+    for (int j = 0; j < 64; j++) {
+      io_uring_prep_write(io_uring_get_sqe(&ring), fd, "hello ", 6);
+    }
+    if (io_uring_submit(&ring) != 64) {
       printf("write file failed!\n");
       while (1)
         ;
     }
+    struct io_uring_cqe *cqe;
+    while ((cqe = io_uring_peek_cqe(&ring))) {
+      if (cqe->res != 6) {
+        printf("write file failed!\n");
+        while (1)
+          ;
+      }
+      io_uring_cqe_seen(&ring);
+    }
   }
   sfs_close(fd);
   // read many more hello
-  fd = sfs_open("/test3/big", SFS_FLAG_READ);
-  if (fd < 0) {
+  // 通过带缓冲的流读，每读满一个缓冲区才陷入内核一次
+  FILE *f = fopen("/test3/big", "r");
+  if (f == NULL) {
     printf("open file failed!\n");
     while (1)
       ;
@@ -39,14 +59,13 @@ int main() {
   printf("reading ...\n");
   char buf[10];
   for (int i = 0; i < 4096; i++) {
-    int len = sfs_read(fd, buf, 6);
-    if (len != 6 || memcmp(buf, "hello ", 6) != 0) {
+    if (fread(buf, 1, 6, f) != 6 || memcmp(buf, "hello ", 6) != 0) {
       printf("read file failed!\n");
       while (1)
         ;
     }
   }
-  sfs_close(fd);
+  fclose(f);
 
   printf("\033[32m[write/read big file pass]\033[0m\n");
   return 0;
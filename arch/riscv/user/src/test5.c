@@ -1,5 +1,6 @@
 #include "fs.h"
 #include "getchar.h"
+#include "malloc.h"
 #include "mm.h"
 #include "proc.h"
 #include "stdio.h"
@@ -14,21 +15,19 @@ int main() {
   char input[64];
   int n = 0, ch;
 
-  char *path = 0x0;
-  mmap(0, 1024, PTE_V | PTE_U | PTE_R | PTE_W, 0, 0, 0);
+  char *path = malloc(1024);
   path[0] = '/';
   path[1] = '.';
+  path[2] = '\0';
 
   char tmp[10][28];
   char *filename[10];
   for (int i = 0; i < 10; i++)
     filename[i] = tmp[i];
 
-  char *copy = (char *)0x10000;
-  mmap(copy, 1024, PTE_V | PTE_U | PTE_R | PTE_W, 0, 0, 0);
+  char *copy = malloc(1024);
 
-  char * content = (char *)0x1000;
-  mmap(content, 0x1000, PTE_V | PTE_R | PTE_W | PTE_U, 0, 0, 0);
+  char *content = malloc(0x1000);
 
   printf("fssh support: \n");
   printf("> ls\n");
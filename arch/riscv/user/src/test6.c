@@ -0,0 +1,104 @@
+#include "getchar.h"
+#include "mm.h"
+#include "pipe.h"
+#include "proc.h"
+#include "stdio.h"
+
+#define PAGE_SIZE 4096
+#define NPAGES 4
+
+int memcmp(const char *a, const char *b, int len) {
+  while (len--) {
+    if (*a != *b)
+      return 1;
+    a++;
+    b++;
+  }
+  return 0;
+}
+
+// vmsplice 只整页搬运堆上按页对齐的页
+char *heap_pages(int n) {
+  uint64_t raw = (uint64_t)sbrk((n + 1) * PAGE_SIZE);
+  return (char *)((raw + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1));
+}
+
+int main() {
+  int to_child[2], to_parent[2];
+  if (pipe(to_child) < 0 || pipe(to_parent) < 0) {
+    printf("pipe failed!\n");
+    while (1)
+      ;
+  }
+
+  int pid = fork();
+  if (pid == 0) {
+    close(to_child[1]);
+    close(to_parent[0]);
+    // 把收到的消息原样送回
+    char buf[16];
+    long n = read(to_child[0], buf, sizeof(buf));
+    if (n <= 0 || write(to_parent[1], buf, n) != n)
+      exit(1);
+
+    // 整页移入管道，之后自己这边读出来是 0
+    char *pages = heap_pages(NPAGES);
+    for (int i = 0; i < NPAGES * PAGE_SIZE; i++)
+      pages[i] = (char)(i / PAGE_SIZE + 1);
+    if (vmsplice(to_parent[1], pages, NPAGES * PAGE_SIZE) != NPAGES * PAGE_SIZE)
+      exit(2);
+    for (int i = 0; i < NPAGES * PAGE_SIZE; i++) {
+      if (pages[i] != 0)
+        exit(3);
+    }
+    exit(0);
+  }
+
+  close(to_child[0]);
+  close(to_parent[1]);
+  char buf[16];
+  if (write(to_child[1], "ping", 5) != 5 || read(to_parent[0], buf, sizeof(buf)) != 5 ||
+      memcmp(buf, "ping", 5) != 0) {
+    printf("pipe round trip failed!\n");
+    while (1)
+      ;
+  }
+
+  // 管道中的页直接映射到 pages
+  char *pages = heap_pages(NPAGES);
+  long got = 0;
+  while (got < NPAGES * PAGE_SIZE) {
+    long n = vmsplice(to_parent[0], pages + got, NPAGES * PAGE_SIZE - got);
+    if (n <= 0) {
+      printf("vmsplice failed!\n");
+      while (1)
+        ;
+    }
+    got += n;
+  }
+  for (int i = 0; i < NPAGES * PAGE_SIZE; i++) {
+    if (pages[i] != (char)(i / PAGE_SIZE + 1)) {
+      printf("vmsplice data error!\n");
+      while (1)
+        ;
+    }
+  }
+
+  // 子进程退出后写端全部关闭，读到 EOF
+  int status;
+  if (waitpid(pid, &status) != pid || status != 0) {
+    printf("child failed: %d\n", status);
+    while (1)
+      ;
+  }
+  if (read(to_parent[0], buf, 1) != 0) {
+    printf("no EOF after writers closed!\n");
+    while (1)
+      ;
+  }
+  close(to_child[1]);
+  close(to_parent[0]);
+
+  printf("\033[32m[pipe and vmsplice pass]\033[0m\n");
+  return 0;
+}
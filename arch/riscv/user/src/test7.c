@@ -0,0 +1,70 @@
+#include "mm.h"
+#include "pipe.h"
+#include "proc.h"
+#include "shm.h"
+#include "stdio.h"
+#include "thread.h"
+
+#define SHM_ADDR 0x8000000
+#define ROUNDS 256
+
+// 生产者写一个数就把 seq 加一，消费者在 seq 上等待
+struct channel {
+  volatile uint32_t seq;
+  int data[ROUNDS];
+};
+
+int main() {
+  int fd = shm_open("/test7", O_CREAT | O_EXCL | O_RDWR);
+  if (fd < 0 || ftruncate(fd, sizeof(struct channel)) < 0) {
+    printf("shm_open failed!\n");
+    while (1)
+      ;
+  }
+  struct channel *ch = mmap((void *)SHM_ADDR, 4096, PTE_V | PTE_R | PTE_W | PTE_U,
+                            MAP_SHARED, fd, 0);
+  if (ch != (void *)SHM_ADDR) {
+    printf("mmap shm failed!\n");
+    while (1)
+      ;
+  }
+  // 关闭 fd 不影响已有的映射，fork 后子进程映射的是同一批物理页
+  close(fd);
+
+  int pid = fork();
+  if (pid == 0) {
+    for (int i = 0; i < ROUNDS; i++) {
+      ch->data[i] = i * i;
+      __atomic_store_n(&ch->seq, i + 1, __ATOMIC_RELEASE);
+      futex_wake(&ch->seq, 1);
+    }
+    exit(0);
+  }
+
+  long sum = 0, expect = 0;
+  for (int i = 0; i < ROUNDS; i++) {
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&ch->seq, __ATOMIC_ACQUIRE)) <= (uint32_t)i)
+      futex_wait(&ch->seq, seq);
+    sum += ch->data[i];
+    expect += (long)i * i;
+  }
+  int status;
+  if (waitpid(pid, &status) != pid || status != 0 || sum != expect) {
+    printf("shm producer/consumer failed!\n");
+    while (1)
+      ;
+  }
+
+  // 删除名字之后不能再按名字打开，已有的映射仍然有效
+  if (shm_unlink("/test7") < 0 || shm_open("/test7", O_RDWR) >= 0 ||
+      ch->data[ROUNDS - 1] != (ROUNDS - 1) * (ROUNDS - 1)) {
+    printf("shm_unlink failed!\n");
+    while (1)
+      ;
+  }
+  munmap(ch, 4096);
+
+  printf("\033[32m[shm producer/consumer pass]\033[0m\n");
+  return 0;
+}
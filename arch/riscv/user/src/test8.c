@@ -0,0 +1,83 @@
+#include "malloc.h"
+#include "stdio.h"
+#include "thread.h"
+
+#define NTHREADS 4
+#define ITERS 10000
+#define STACK_SIZE 16384
+
+mutex_t lock = MUTEX_INITIALIZER;
+cond_t start_cond = COND_INITIALIZER;
+cond_t done_cond = COND_INITIALIZER;
+int started = 0;
+int finished = 0;
+long counter = 0;
+
+int worker(void *arg) {
+  long id = (long)arg;
+  // 等主线程把所有线程都创建好再一起开始，尽量制造竞争
+  mutex_lock(&lock);
+  while (!started)
+    cond_wait(&start_cond, &lock);
+  mutex_unlock(&lock);
+
+  for (int i = 0; i < ITERS; i++) {
+    mutex_lock(&lock);
+    counter++;
+    mutex_unlock(&lock);
+    // 顺便让每个线程的 malloc 缓存也跑一跑
+    if (i % 100 == 0) {
+      long *p = malloc(sizeof(long));
+      *p = id;
+      if (*p != id)
+        return 1;
+      free(p);
+    }
+  }
+
+  mutex_lock(&lock);
+  finished++;
+  cond_signal(&done_cond);
+  mutex_unlock(&lock);
+  return 0;
+}
+
+int main() {
+  int tids[NTHREADS];
+  char *stacks[NTHREADS];
+  for (long i = 0; i < NTHREADS; i++) {
+    stacks[i] = malloc(STACK_SIZE);
+    void *top = (void *)(((uint64_t)stacks[i] + STACK_SIZE) & ~(uint64_t)15);
+    tids[i] = thread_create(worker, (void *)i, top);
+    if (tids[i] < 0) {
+      printf("thread_create failed!\n");
+      while (1)
+        ;
+    }
+  }
+
+  mutex_lock(&lock);
+  started = 1;
+  cond_broadcast(&start_cond);
+  while (finished < NTHREADS)
+    cond_wait(&done_cond, &lock);
+  mutex_unlock(&lock);
+
+  for (int i = 0; i < NTHREADS; i++) {
+    if (thread_join(tids[i]) != 0) {
+      printf("thread %d failed!\n", tids[i]);
+      while (1)
+        ;
+    }
+    // 回收之后线程不再使用它的栈
+    free(stacks[i]);
+  }
+  if (counter != (long)NTHREADS * ITERS) {
+    printf("counter error: %d\n", (int)counter);
+    while (1)
+      ;
+  }
+
+  printf("\033[32m[thread mutex and cond pass]\033[0m\n");
+  return 0;
+}
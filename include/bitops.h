@@ -0,0 +1,32 @@
+#pragma once
+
+#include "defs.h"
+
+/* 返回 word 中最低的置位位的下标，word 不能为 0（不依赖 libgcc 的 __ctzdi2） */
+static inline unsigned long __ffs(uint64_t word) {
+  unsigned long num = 0;
+  if ((word & 0xffffffff) == 0) {
+    num += 32;
+    word >>= 32;
+  }
+  if ((word & 0xffff) == 0) {
+    num += 16;
+    word >>= 16;
+  }
+  if ((word & 0xff) == 0) {
+    num += 8;
+    word >>= 8;
+  }
+  if ((word & 0xf) == 0) {
+    num += 4;
+    word >>= 4;
+  }
+  if ((word & 0x3) == 0) {
+    num += 2;
+    word >>= 2;
+  }
+  if ((word & 0x1) == 0)
+    num += 1;
+  return num;
+}
+
@@ -0,0 +1,31 @@
+#pragma once
+#include "defs.h"
+
+// 串口的输入、输出都经过环形缓冲区，由 UART 中断驱动：
+// UART 中断经 PLIC 进入 M 模式的 m_ext_handler，由 console_intr 把收到的字节搬进输入环、
+// 把输出环中的字节填进发送 FIFO，再置位 SSIP 通知 S 模式；
+// S 模式在中断返回和 idle 时调用 console_wakeup 唤醒等待输入或等待输出空间的进程。
+// M 模式不经过页表，而且可能打断持有任意锁的 S 模式代码，所以不能加锁：
+// 两个环都是无锁的单生产者单消费者队列，M 模式只推进 rx_w 和 tx_r，
+// 其余的下标由持有相应锁的 S 模式代码推进。
+
+#define CONSOLE_RX_BUF_SIZE 256
+#define CONSOLE_TX_BUF_SIZE 4096
+
+/* 打开 UART 的 FIFO 和接收中断，之后的输出都经过输出环 */
+void console_init(void);
+
+/* M 模式下调用：处理 UART 的接收和发送中断 */
+void console_intr(void);
+
+/* 环的状态有变化时唤醒等待的进程，调用时不能持有任何锁 */
+void console_wakeup(void);
+
+/* 读取最多 count 个字节，没有输入时睡眠，返回读到的字节数 */
+long console_read(char *buf, uint64_t count);
+
+/* 把 count 个字节放入输出环后立即返回，环满时睡眠等待，返回 count */
+long console_write(const char *buf, uint64_t count);
+
+/* 同 console_write，但不会睡眠，环满时忙等，可在任何上下文中调用 */
+void console_write_atomic(const char *buf, uint64_t count);
@@ -0,0 +1,54 @@
+#pragma once
+#include "defs.h"
+
+// ELF64 文件格式中 exec 用到的部分：文件头和程序头（segment）
+
+#define EI_NIDENT 16
+
+#define ELFMAG0 0x7f
+#define ELFMAG1 'E'
+#define ELFMAG2 'L'
+#define ELFMAG3 'F'
+#define EI_CLASS 4
+#define EI_DATA 5
+#define ELFCLASS64 2
+#define ELFDATA2LSB 1
+
+#define ET_EXEC 2
+#define EM_RISCV 243
+
+/* p_type */
+#define PT_LOAD 1
+
+/* p_flags */
+#define PF_X 0x1
+#define PF_W 0x2
+#define PF_R 0x4
+
+typedef struct {
+  unsigned char e_ident[EI_NIDENT];
+  uint16_t e_type;
+  uint16_t e_machine;
+  uint32_t e_version;
+  uint64_t e_entry;
+  uint64_t e_phoff;     // 程序头表在文件中的偏移
+  uint64_t e_shoff;
+  uint32_t e_flags;
+  uint16_t e_ehsize;
+  uint16_t e_phentsize;
+  uint16_t e_phnum;
+  uint16_t e_shentsize;
+  uint16_t e_shnum;
+  uint16_t e_shstrndx;
+} Elf64_Ehdr;
+
+typedef struct {
+  uint32_t p_type;
+  uint32_t p_flags;
+  uint64_t p_offset;    // 段在文件中的偏移
+  uint64_t p_vaddr;     // 段的虚拟地址
+  uint64_t p_paddr;
+  uint64_t p_filesz;    // 段在文件中的大小
+  uint64_t p_memsz;     // 段在内存中的大小，超出 p_filesz 的部分（bss）填 0
+  uint64_t p_align;
+} Elf64_Phdr;
@@ -0,0 +1,27 @@
+#pragma once
+#include "defs.h"
+
+// exec：从 SFS 中装入 ELF 可执行文件。
+// 每个 PT_LOAD 段映射为一个 MAP_PRIVATE 的文件映射 VMA（见 filemap.h），exec 时不读任何数据页，
+// 页在第一次访问时才从 SFS 缓存映射进来，开销只与实际用到的页数有关。
+// 只读的代码段直接映射缓存块，运行同一个程序的进程共享这些物理页；可写的数据段第一次写时复制。
+// bss 中与文件数据同页的部分在 exec 时清零，其余部分是逐页分配的匿名 VMA（VM_PAGED）。
+// 程序不再链接进内核，放进 sfs.img 就能运行。
+
+#define EXEC_PATH_MAX 64
+#define EXEC_MAX_PHDRS 16
+
+/* 第一个用户进程运行的程序 */
+#define INIT_PATH "/init"
+
+/* 从用户地址 src 拷贝要 exec 的路径到 dst（EXEC_PATH_MAX 字节），
+ * 没有当前目录，不以 '/' 开头的名字从根目录查找，失败返回 -1 */
+int copy_exec_path(char *dst, const char *src);
+
+/* 用 SFS 中的 ELF 文件 path 替换 current 的地址空间，成功返回 0 并把入口地址写入 *entry；
+ * 文件不存在或格式不对时返回 -1，原来的地址空间不受影响；
+ * 返回 -2 表示原来的地址空间已经释放，进程无法继续运行 */
+int do_execve(const char *path, uint64_t *entry);
+
+/* 第一个用户进程第一次被调度时调用，装入 INIT_PATH 并返回入口地址 */
+uint64_t exec_init(void);
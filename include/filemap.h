@@ -0,0 +1,28 @@
+#pragma once
+
+#include "defs.h"
+#include "task_manager.h"
+
+// 文件映射（file-backed mmap）：
+// VMA 的每一页直接映射 SFS 缓存中的数据块，vma->vm_pages[i] 记录第 i 页对应的缓存块。
+// MAP_SHARED：首次写触发缺页时把缓存块标记为 dirty，之后由缓存正常写回；
+// MAP_PRIVATE：缓存块以只读方式映射，首次写时复制到私有页（vm_pages[i] 置 NULL）。
+
+/* 文件映射 VMA 的页数 */
+#define vma_pages(vma) (((vma)->vm_end - (vma)->vm_start - 1) / PAGE_SIZE + 1)
+
+/* 处理文件映射 VMA 在 addr 处的缺页，write 表示是否为写访问，失败返回 -1 */
+int filemap_fault(struct mm_struct *mm, uint64_t *pgtbl,
+                  struct vm_area_struct *vma, uint64_t addr, bool write);
+
+/* 将文件映射 VMA 中文件范围内的所有页读入并建立映射 */
+int filemap_populate(struct mm_struct *mm, uint64_t *pgtbl,
+                     struct vm_area_struct *vma);
+
+/* 解除文件映射 VMA 的所有页映射，释放私有副本并归还缓存块引用 */
+void filemap_zap(struct mm_struct *mm, uint64_t *pgtbl,
+                 struct vm_area_struct *vma);
+
+/* fork 时复制文件映射：共享缓存块，私有副本逐页拷贝 */
+int filemap_copy(uint64_t *dst_pgtbl, uint64_t *src_pgtbl,
+                 struct vm_area_struct *dst, struct vm_area_struct *src);
@@ -0,0 +1,32 @@
+#pragma once
+#include "defs.h"
+
+// 浮点寄存器的惰性保存与恢复：
+// 切换进程时只有 sstatus.FS 为 Dirty（换出的进程改过浮点寄存器）才保存，
+// 随后把 FS 置为 Off。新进程第一次执行浮点指令时触发非法指令异常，
+// 此时才恢复它的浮点状态并把 FS 置为 Clean。若本 hart 的浮点寄存器里
+// 仍是该进程的状态（cpu->fp_owner），连恢复也可以省掉。
+// 不使用浮点的进程除了切换时读一次 sstatus 之外没有任何开销。
+
+struct task_struct;
+
+struct fp_state {
+  uint64_t f[32];
+  uint64_t fcsr;
+};
+
+/* 在 __switch_to 之前调用：需要时保存 prev 的浮点状态，并关闭浮点单元 */
+void fp_switch_out(struct task_struct *prev);
+
+/* 非法指令异常时调用：若是浮点单元关闭导致的，恢复 current 的浮点状态并返回 1 */
+bool fp_trap(void);
+
+/* 把 current 尚未保存的浮点寄存器写回 current->fp，fork 复制前调用 */
+void fp_flush(void);
+
+/* 丢弃 current 的浮点状态，exec 时调用 */
+void fp_reset(void);
+
+/* 见 entry.S */
+extern void __fp_save(struct fp_state *fp);
+extern void __fp_restore(struct fp_state *fp);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "defs.h"
+#include "spinlock.h"
 
 #define SFS_MAX_INFO_LEN     32
 #define SFS_MAGIC            0x1f2f3f4f
@@ -20,6 +21,9 @@
 
 #define min(a,b) (a>b?b:a)
 
+/* 系统调用中 SFS 路径的最大长度（含结尾的 '\0'） */
+#define SFS_PATH_MAX 256
+
 struct sfs_super {
     uint32_t magic;
     uint32_t blocks;
@@ -43,6 +47,9 @@ struct sfs_entry {
 
 
 
+/* SFS 的缓存和磁盘都只有一份：sfs_* 系统调用和文件映射的缺页处理都要持有这把锁 */
+extern struct spinlock fs_lock;
+
 /**
  * 功能: 初始化 simple file system
  * @ret : 成功初始化返回 0，否则返回非 0 值
@@ -108,7 +115,7 @@ int sfs_write(int fd, char* buf, uint32_t len);
 /**
  * 功能    : 获取 path 下的所有文件名，并存储在 files 数组中
  * @path  : 文件夹路径 (绝对路径)
- * @files : 保存该文件夹下所有的文件名
+ * @files : 保存该文件夹下所有的文件名，为 NULL 时只统计文件个数
  * @ret   : > 0 表示该文件夹下有多少文件
  *          = 0 表示该 path 是一个文件
  *          < 0 表示出错
@@ -134,6 +141,8 @@ struct sfs_memory_block {
      uint32_t blockno;     // block 编号
      bool dirty;           // 脏位，保证写回数据
      int reclaim_count;    // 指向次数，因为硬链接有可能会打开同一个 inode，所以需要记录次数
+     int map_count;        // 被用户页表直接映射（mmap）的次数，> 0 时缓冲区不能释放
+     struct sfs_memory_block* next; // 被挤出 hash 但仍被映射的块组成的链表
 };
 
 typedef struct sfs_super* SUPER;
@@ -146,6 +155,7 @@ struct sfs_fs {
     char freemap[4096];           // freemap 区域管理，可自行设计
     bool super_dirty;          // 超级块或 freemap 区域是否有修改
     Mblock hash[256];
+    Mblock detached;           // 被挤出 hash 但仍被 mmap 映射的数据块
     uint32_t size;
 };
 
@@ -177,4 +187,25 @@ Mblock create_data();
 
 Mblock create_dir(char* name, Mblock dir);
 
-Mblock create_file(char* name, Mblock dir);
\ No newline at end of file
+Mblock create_file(char* name, Mblock dir);
+
+/**
+ * 功能: 返回文件第 index 个数据块在缓存中的 Mblock (供 mmap 使用)
+ * @inode_no : 文件 inode 所在的块号
+ * @index    : 文件内的块序号
+ * @ret      : 超出文件末尾返回 NULL
+ */
+Mblock sfs_get_data_block(uint32_t inode_no, uint32_t index);
+
+/**
+ * 功能: 按路径查找普通文件，不占用 fd (供 exec 使用)
+ * @path : 文件路径 (绝对路径)
+ * @size : 找到时写入文件大小
+ * @ret  : 文件 inode 所在的块号，找不到或是目录时返回 0
+ */
+uint32_t sfs_lookup(const char* path, uint32_t* size);
+
+/**
+ * 功能: 解除一次 mmap 对缓存块的引用，最后一个引用解除且该块已不在 hash 中时写回并释放
+ */
+void sfs_unmap_block(Mblock mem);
@@ -0,0 +1,21 @@
+#pragma once
+#include "defs.h"
+
+// futex：按用户地址睡眠和唤醒，用户库的锁只在竞争时才陷入内核。
+// 等待者以 uaddr 所在的物理地址为键挂在哈希桶上，所以同一进程的线程之间、
+// 以及映射了同一块共享内存（见 shm.h）的进程之间都可以使用。
+// FUTEX_WAIT 在桶锁内检查 *uaddr == val 后才睡眠，与修改 *uaddr 之后调用的 FUTEX_WAKE
+// 由同一把桶锁串行化，不会丢失唤醒。
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+#define FUTEX_HASH_SIZE 32
+
+void futex_init(void);
+
+/* *uaddr 等于 val 时睡眠直到被 futex_wake 唤醒，返回 0；不相等或地址非法时返回 -1 */
+long futex_wait(uint32_t *uaddr, uint32_t val);
+
+/* 唤醒最多 n 个在 uaddr 上等待的进程，返回唤醒的个数 */
+long futex_wake(uint32_t *uaddr, uint32_t n);
@@ -0,0 +1,83 @@
+#pragma once
+#include "defs.h"
+#include "spinlock.h"
+#include "wait.h"
+
+// 批量提交 SFS 操作的共享环（仿 io_uring）：
+// io_uring_setup 在用户指定的地址映射一块用户与内核共享的内存，开头是 struct io_rings，
+// 后面依次是提交队列（SQ）和完成队列（CQ）。用户填好 SQE 后推进 sq_tail，
+// 内核处理后推进 sq_head，并把结果写入 CQ、推进 cq_tail；用户读完 CQE 后推进 cq_head。
+// 一次 io_uring_enter 处理队列中的全部请求，整批只需陷入一次内核。
+// 每个请求与对应的系统调用走同一个入口（sys_call_table），fd 可以是管道，缓冲区可以还没有分配物理页。
+// IORING_SETUP_SQPOLL：进程每次因时钟中断进入内核时，内核顺便处理它的 SQ，
+// 用户只需写 SQ、读 CQ，完全不用 ecall（代价是请求最迟在下一个 tick 才被处理）。
+// 环形队列的布局与用户库 io_uring.h 中的定义一致。
+
+#define IORING_MAX_ENTRIES 256
+
+/* io_uring_setup 的 flags */
+#define IORING_SETUP_SQPOLL 0x1
+
+/* 一个请求：opcode 为 SFS_* 系统调用号，args 与对应系统调用的参数相同 */
+struct io_uring_sqe {
+  uint64_t opcode;
+  uint64_t args[3];
+  uint64_t user_data; // 原样带回 CQE
+};
+
+struct io_uring_cqe {
+  uint64_t user_data;
+  int64_t res; // 与对应系统调用的返回值相同
+};
+
+/* 共享内存开头的控制信息，head/tail 只增不减，取下标时与 mask 相与 */
+struct io_rings {
+  uint32_t sq_head; // 内核推进
+  uint32_t sq_tail; // 用户推进
+  uint32_t sq_mask;
+  uint32_t sq_entries;
+  uint32_t cq_head; // 用户推进
+  uint32_t cq_tail; // 内核推进
+  uint32_t cq_mask;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_off;  // SQE 数组相对共享内存起始处的偏移
+  uint32_t cq_off;  // CQE 数组相对共享内存起始处的偏移
+  uint32_t resv;
+};
+
+/* 内核保存的环信息，每个地址空间最多一个。
+ * io_rings 中的 mask、entries 用户可以随意改写，内核取下标只用这里的副本 */
+struct io_ring_ctx {
+  struct io_rings *rings; // 物理地址，内核直接访问
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  uint32_t sq_mask;
+  uint32_t cq_mask;
+  uint32_t cq_entries;
+  uint64_t user_addr;     // 在用户地址空间中的起始地址
+  uint64_t size;
+  uint32_t flags;
+  // 同一地址空间的线程共享一个环：同一时刻只有一个提交者（busy），其他提交者在 wait 上等待。
+  // 提交时可能缺页或在管道上睡眠，所以不能一直持有自旋锁 lock，lock 只保护 busy 和 dead
+  struct spinlock lock;
+  struct wait_queue_head wait;
+  bool busy;
+  bool dead;              // 环已被解除映射，不再处理请求
+  int refs;               // mm->uring 和正在提交的线程各持有一个，最后一个引用释放环的页
+};
+
+struct mm_struct;
+struct vm_area_struct;
+
+/* 在 addr 处建立 entries 项的 SQ 和 2 * entries 项的 CQ，返回共享内存的大小，失败返回 -1 */
+long io_uring_setup(uint64_t addr, uint32_t entries, uint32_t flags);
+
+/* 处理 SQ 中最多 to_submit 个请求，返回处理的个数，没有建立环时返回 -1 */
+long io_uring_enter(uint32_t to_submit);
+
+/* 时钟中断中调用：若 current 的环处于 SQPOLL 模式，处理它的 SQ */
+void io_uring_sqpoll(void);
+
+/* 环所在的 VMA 被解除映射时调用（持有 mm->lock），解除 mm 对环的引用，环的页随最后一个引用释放 */
+void io_uring_release(struct mm_struct *mm);
@@ -0,0 +1,26 @@
+#pragma once
+#include "defs.h"
+
+struct task_struct;
+
+// 内核线程：与所有进程共用内核地址空间（启动页表，ASID 0），没有用户 mm，
+// 也不会回到 U 模式。S 模式下中断是关闭的，时钟中断不会打断内核线程，
+// 长时间运行的内核线程需要主动调用 cond_resched 让出 CPU。
+
+/* 创建内核线程，执行 fn(arg)，fn 返回后线程退出。新线程处于睡眠状态，
+ * 需要用 wake_up_process 启动；失败返回 NULL */
+struct task_struct *kthread_create(int (*fn)(void *), void *arg,
+                                   const char *name);
+
+/* 创建并立即启动内核线程 */
+struct task_struct *kthread_run(int (*fn)(void *), void *arg,
+                                const char *name);
+
+/* 结束当前内核线程，不会返回 */
+void kthread_exit(int code);
+
+/* 在 current 时间片用完或有 IPI 要求重新调度时让出 CPU，供内核线程在循环中调用 */
+void cond_resched(void);
+
+/* 内核线程第一次被调度时的入口，见 entry.S */
+extern void ret_from_kthread(void);
@@ -31,6 +31,11 @@ uint64_t alloc_page();
 
 void free_pages(uint64_t pa);
 
+/* 单个物理页的引用计数：get_page 增加一个引用，put_page 减少一个，减到 0 时释放该页。
+ * 只有同时映射在多个地址空间中的页（如 shm.h 的共享内存）使用，其他页仍直接 free_pages */
+void get_page(uint64_t pa);
+void put_page(uint64_t pa);
+
 void slub_init();
 
 void memcpy(void * dst, void * src, size_t size);
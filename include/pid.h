@@ -0,0 +1,25 @@
+#pragma once
+#include "defs.h"
+
+struct task_struct;
+
+// 以下函数都要求调用者持有 tasklist_lock
+
+/* pid 的取值范围 [0, PID_MAX) */
+#define PID_MAX 32768
+
+/* pid -> task 哈希表的桶数 */
+#define PIDHASH_SZ 256
+
+/* 分配一个未使用的 pid，从上一次分配的 pid 之后开始找，用尽时返回 -1 */
+long alloc_pid(void);
+
+/* 归还 pid */
+void free_pid(long pid);
+
+/* 把 p 加入 / 移出 pid 哈希表 */
+void attach_pid(struct task_struct *p);
+void detach_pid(struct task_struct *p);
+
+/* 根据 pid 查找 task，找不到返回 NULL */
+struct task_struct *find_task_by_pid(long pid);
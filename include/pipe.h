@@ -0,0 +1,65 @@
+#pragma once
+#include "defs.h"
+#include "spinlock.h"
+#include "wait.h"
+
+// 管道：由 PIPE_BUFFERS 个槽组成的环，每个槽持有一页及页内有效数据的范围。
+// read/write 按字节拷贝，写入时尽量接在最后一页的后面。
+// vmsplice 整页搬运，不拷贝数据：写端把用户的匿名页直接挂进环（用户那一页随之解除映射，
+// 再访问时得到新的零页），读端把环中的整页直接映射到用户地址。
+// 管道的两端是 files_struct 中 type 为 FILE_PIPE 的 struct file，fork 时子进程继承。
+// 写端全部关闭后读到 0（EOF），读端全部关闭后写返回 -1。
+
+#define PIPE_BUFFERS 16
+
+/* struct file 的 type */
+#define FILE_SFS 0
+#define FILE_PIPE 1
+#define FILE_SHM 2 // 共享内存对象，见 shm.h
+
+struct pipe_buffer {
+  uint64_t page;   // 物理页
+  uint32_t offset; // 有效数据在页内的起始位置
+  uint32_t len;    // 有效数据的长度
+};
+
+struct pipe {
+  struct spinlock lock;
+  struct wait_queue_head rd_wait; // 等待数据的读者
+  struct wait_queue_head wr_wait; // 等待空槽的写者
+  struct pipe_buffer bufs[PIPE_BUFFERS];
+  uint32_t head;                  // 下一个写入的槽，只增不减
+  uint32_t tail;                  // 下一个读取的槽，只增不减
+  int readers;                    // 打开的读端个数
+  int writers;                    // 打开的写端个数
+};
+
+struct file;
+struct files_struct;
+
+/* 创建管道，把读端、写端的 fd 写入 fds[0]、fds[1]，失败返回 -1 */
+long do_pipe(int *fds);
+
+/* fd 是管道的一端时取得对应 struct file 的引用并返回，否则返回 NULL，用完后 fput */
+struct file *fget_pipe(int fd);
+
+/* 没有数据时睡眠，返回读到的字节数，写端全部关闭时返回 0 */
+long pipe_read(struct file *f, char *buf, uint64_t count);
+
+/* 空间不足时睡眠直到全部写入，返回写入的字节数，读端全部关闭时返回 -1 */
+long pipe_write(struct file *f, const char *buf, uint64_t count);
+
+/* 在用户内存和管道之间整页搬运，不满一页或不能搬运的部分退化为拷贝，返回处理的字节数 */
+long pipe_vmsplice(struct file *f, uint64_t addr, uint64_t len);
+
+/* 让 newfd 指向管道 oldfd 的同一端，newfd 原来是管道时先关闭，返回 newfd */
+long do_dup2(int oldfd, int newfd);
+
+/* 关闭管道的一端并释放 f，由 fput 在最后一个引用释放时调用 */
+void pipe_close(struct file *f);
+
+/* fork 时子进程继承父进程的管道 fd */
+int copy_pipes(struct files_struct *dst, struct files_struct *src);
+
+/* 进程退出时关闭它的管道 fd */
+void exit_pipes(struct files_struct *files);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "defs.h"
+#include "list.h"
+
+/*
+ * Minimal Linux-like red-black tree.
+ *
+ * The tree is intrusive like list.h: embed a struct rb_node in the container
+ * and use rb_entry() to get back to it. Searching and choosing the insert
+ * position is left to the caller, who then calls rb_link_node() followed by
+ * rb_insert_color() to rebalance.
+ */
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+struct rb_node {
+  struct rb_node *rb_parent;
+  struct rb_node *rb_left;
+  struct rb_node *rb_right;
+  int rb_color;
+};
+
+struct rb_root {
+  struct rb_node *rb_node;
+};
+
+#define RB_ROOT ((struct rb_root){NULL})
+
+#define rb_entry(ptr, type, member) container_of(ptr, type, member)
+
+#define RB_EMPTY_ROOT(root) ((root)->rb_node == NULL)
+
+/**
+ * rb_link_node() - Attach a new node below parent at the given link
+ * @node: the new node
+ * @parent: the future parent, NULL if the tree is empty
+ * @link: &parent->rb_left, &parent->rb_right or &root->rb_node
+ */
+static __inline__ void rb_link_node(struct rb_node *node,
+                                    struct rb_node *parent,
+                                    struct rb_node **link) {
+  node->rb_parent = parent;
+  node->rb_left = node->rb_right = NULL;
+  node->rb_color = RB_RED;
+  *link = node;
+}
+
+/* Rebalance the tree after rb_link_node() */
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+
+/* Remove node from the tree and rebalance */
+void rb_erase(struct rb_node *node, struct rb_root *root);
+
+/* In-order traversal helpers, NULL when there is no such node */
+struct rb_node *rb_first(const struct rb_root *root);
+struct rb_node *rb_last(const struct rb_root *root);
+struct rb_node *rb_next(const struct rb_node *node);
+struct rb_node *rb_prev(const struct rb_node *node);
@@ -37,4 +37,16 @@
 
 #define rdtime() read_csr(time)
 #define rdcycle() read_csr(cycle)
-#define rdinstret() read_csr(instret)
\ No newline at end of file
+#define rdinstret() read_csr(instret)
+
+/* sstatus.FS：浮点单元状态 */
+#define SSTATUS_FS (3UL << 13)
+#define SSTATUS_FS_OFF (0UL << 13)
+#define SSTATUS_FS_INITIAL (1UL << 13)
+#define SSTATUS_FS_CLEAN (2UL << 13)
+#define SSTATUS_FS_DIRTY (3UL << 13)
+
+#define SIP_SSIP (1UL << 1)
+#define SIP_STIP (1UL << 5)
+
+#define wfi() asm volatile("wfi" ::: "memory")
@@ -0,0 +1,28 @@
+#pragma once
+
+// S 模式通过 ecall 请求 M 模式（head.S 中的 encall_from_s）完成的操作，
+// a7 为功能号，编号沿用 legacy SBI
+
+#define SBI_SET_TIMER 0
+#define SBI_SEND_IPI 4
+
+#ifndef __ASSEMBLER__
+#include "defs.h"
+
+static inline void sbi_call(uint64_t which, uint64_t arg0) {
+  register uint64_t a0 asm("a0") = arg0;
+  register uint64_t a7 asm("a7") = which;
+  asm volatile("ecall" : "+r"(a0) : "r"(a7) : "memory");
+}
+
+/* 把本 hart 的 mtimecmp 设置为 stime_value */
+static inline void sbi_set_timer(uint64_t stime_value) {
+  sbi_call(SBI_SET_TIMER, stime_value);
+}
+
+/* 向 hart_mask 中的每个 hart 发送软件中断，对方在 S 模式下收到 SSIP */
+static inline void sbi_send_ipi(uint64_t hart_mask) {
+  sbi_call(SBI_SEND_IPI, hart_mask);
+}
+
+#endif
@@ -1,19 +1,109 @@
 #pragma once
 #include "task_manager.h"
+#include "timer.h"
 
 #ifndef __ASSEMBLER__
 
+/* 每个 hart 一个 runqueue。每个优先级一个队列，bitmap 记录哪些优先级的队列非空 */
+struct runqueue {
+  struct spinlock lock;
+  uint64_t cpu;
+  uint64_t bitmap;
+  struct list_head queue[MAX_PRIO];
+  unsigned long nr_running;
+
+  /* SCHED_FAIR：按 vruntime 排序的红黑树 */
+  struct rb_root fair_root;
+  unsigned long nr_fair;
+  uint64_t fair_load;    // 树中进程权重之和
+  uint64_t min_vruntime;
+
+  /* 统计信息 */
+  uint64_t nr_switches; // 进程切换次数
+  uint64_t idle_enter;  // 进入 idle 睡眠的次数
+  uint64_t idle_time;   // idle 睡眠的总时长（mtime 计数）
+};
+
+extern struct runqueue runqueues[NR_CPUS];
+
+#define cpu_rq(cpu) (&runqueues[(cpu)])
+#define this_rq() cpu_rq(smp_processor_id())
+#define task_rq(p) cpu_rq((p)->cpu)
+
+/* 时间片范围（tick 数） */
+#define MIN_TIMESLICE MS_TO_TICKS(10)
+#define MAX_TIMESLICE MS_TO_TICKS(200)
+
+/* SCHED_FAIR 的调度周期和最小运行粒度（毫秒），可在编译时修改 */
+#ifndef SCHED_LATENCY_MS
+#define SCHED_LATENCY_MS 20
+#endif
+#ifndef SCHED_MIN_GRANULARITY_MS
+#define SCHED_MIN_GRANULARITY_MS 4
+#endif
+
+extern uint64_t sched_latency;
+extern uint64_t sched_min_granularity;
+
+/* 本 hart 需要在返回用户态前重新调度 */
+#define need_resched (this_cpu()->resched)
+
+/* 为本 hart 创建 idle task，当前的启动流程成为 idle task */
+void init_idle(void);
+
 void call_first_process(void);
 
-/* 在时钟中断处理中被调用 */
+/* idle task 的主循环：没有可运行进程时执行 wfi，永不返回 */
+void cpu_idle(void);
+
+/* 打印调度统计信息 */
+void sched_show_stat(void);
+
+/* 初始化 runqueue */
+void sched_init(void);
+
+/* 将可运行的 task 加入 / 移出它所在 hart 的 runqueue */
+void enqueue_task(struct task_struct *p);
+void dequeue_task(struct task_struct *p);
+
+/* 把新创建的 task 放到最空闲的 hart 上 */
+void wake_up_new_task(struct task_struct *p);
+
+/* 唤醒在等待队列上睡眠的 task，将其放回 runqueue */
+void wake_up_process(struct task_struct *p);
+
+/* 修改 task 的优先级，若 task 在 runqueue 中则移动到新的队列 */
+void set_task_prio(struct task_struct *p, long prio);
+
+/* 修改 task 的调度类，param 对 SCHED_PRIO 为优先级，对 SCHED_FAIR 为 nice，失败返回 -1 */
+int sched_setscheduler(struct task_struct *p, int policy, long param);
+
+/* 公平调度类，见 sched_fair.c */
+void enqueue_task_fair(struct runqueue *rq, struct task_struct *p);
+void dequeue_task_fair(struct runqueue *rq, struct task_struct *p);
+void update_curr_fair(struct runqueue *rq, struct task_struct *p);
+void set_next_task_fair(struct runqueue *rq, struct task_struct *p);
+struct task_struct *pick_next_task_fair(struct runqueue *rq, bool self);
+void task_tick_fair(struct runqueue *rq, struct task_struct *curr);
+
+/* 根据优先级计算 task 的时间片长度 */
+long task_timeslice(struct task_struct *p);
+
+/* 在时钟中断处理中被调用，扣减 current 的时间片 */
 void do_timer(void);
 
+/* 时间片用完后在中断返回前调用，切换到同优先级的下一个进程 */
+void preempt_schedule(void);
+
 /* 调度程序 */
 void schedule(bool self);
 
 /* 切换当前任务current到下一个任务next */
 void switch_to(struct task_struct *next);
 
+/* 切换完成后在新 task 上调用，此后被换下的 task 可以在其他 hart 上运行 */
+void finish_task_switch(void);
+
 extern void __switch_to(struct task_struct *prev, struct task_struct *next);
 
 /* 死循环 */
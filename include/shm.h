@@ -0,0 +1,71 @@
+#pragma once
+#include "defs.h"
+#include "list.h"
+
+// 共享内存对象：一组按页编号的物理页，映射它的所有 VMA 看到的是同一批页，
+// 数据在进程之间传递不需要任何系统调用。
+// 有名字的对象由 shm_open 创建或打开，得到 type 为 FILE_SHM 的 fd，用 ftruncate 设置大小，
+// 再以 MAP_SHARED 把 fd 映射进来；匿名的 MAP_SHARED 映射创建一个没有名字的对象，fork 后父子共享。
+// 对象的页在第一次缺页时才分配，每个映射该页的 PTE 和对象本身各持有一个页引用（get_page），
+// 所以 ftruncate 缩小或对象被释放后，仍在映射中的页要等到解除映射才真正释放。
+// 对象被打开它的 fd 和映射它的 VMA 引用，名字被 shm_unlink 删除（匿名对象没有名字）且
+// 引用全部释放时销毁。
+
+#define SHM_NAME_MAX 32
+
+/* shm_open 的 flags */
+#define O_RDONLY 0x0
+#define O_RDWR 0x2
+#define O_CREAT 0x40
+#define O_EXCL 0x80
+
+struct shm_object {
+  char name[SHM_NAME_MAX];
+  uint64_t npages;        // 对象的大小（页数）
+  uint64_t *pages;        // 每一页的物理地址，0 表示还没有分配
+  int refs;               // 打开的 fd 和映射它的 VMA 的个数
+  bool linked;            // 仍在 shm_list 中，可以被 shm_open 找到
+  struct list_head list;
+};
+
+struct file;
+struct files_struct;
+struct mm_struct;
+struct vm_area_struct;
+
+/* 打开名为 name 的共享内存对象，O_CREAT 时不存在则创建，返回 fd，失败返回 -1 */
+long shm_open(const char *name, int flags);
+
+/* 删除名字，已经打开或映射的进程不受影响 */
+long shm_unlink(const char *name);
+
+/* fd 是共享内存对象时取得对应 struct file 的引用并返回，否则返回 NULL，用完后 fput */
+struct file *fget_shm(int fd);
+
+/* 把对象的大小设置为 len 字节（按页向上取整），缩小时释放超出部分的页 */
+long shm_truncate(struct file *f, uint64_t len);
+
+/* 关闭共享内存 fd 并释放 f，由 fput 在最后一个引用释放时调用 */
+void shm_close(struct file *f);
+
+/* 进程退出时关闭它的共享内存 fd */
+void exit_shm(struct files_struct *files);
+
+/* 为 MAP_SHARED 的 vma 设置 vm_shm：f 为 NULL 时是匿名映射，创建新的对象，失败返回 -1 */
+int shm_mmap(struct vm_area_struct *vma, struct file *f, uint64_t offset);
+
+/* 处理共享内存 VMA 在 addr 处的缺页，超出对象大小时返回 -1 */
+int shm_fault(uint64_t *pgtbl, struct vm_area_struct *vma, uint64_t addr);
+
+/* 为 vma 的所有页建立映射 */
+int shm_populate(uint64_t *pgtbl, struct vm_area_struct *vma);
+
+/* 解除 vma 的所有页映射并归还页引用，对象中的数据保留 */
+void shm_zap(struct mm_struct *mm, uint64_t *pgtbl, struct vm_area_struct *vma);
+
+/* fork 时让子进程的 dst 映射与 src 相同的页，并增加对象的引用 */
+int shm_copy(uint64_t *dst_pgtbl, uint64_t *src_pgtbl,
+             struct vm_area_struct *dst, struct vm_area_struct *src);
+
+/* destroy_vma 时释放 vma 对对象的引用 */
+void shm_put(struct shm_object *shm);
@@ -0,0 +1,68 @@
+#pragma once
+
+/* 支持的最大 hart 数，hartid 不小于 NR_CPUS 的 hart 启动后直接停机 */
+#define NR_CPUS 8
+
+/* 每个 hart 的启动栈和 M 模式栈各占一页，见 vmlinux.lds */
+#define CPU_STACK_STRIDE 0x2000
+
+#ifndef __ASSEMBLER__
+#include "defs.h"
+#include "riscv.h"
+
+struct task_struct;
+
+/* IPI 类型，按位记录在 cpu->ipi_pending 中 */
+#define IPI_RESCHEDULE 0x1 // 有新的可运行进程，需要重新调度
+#define IPI_TLB_FLUSH 0x2  // 刷新本 hart 的 TLB
+
+/* 每个 hart 的私有数据，S 模式下 tp 寄存器指向本 hart 的 struct cpu */
+struct cpu {
+  struct task_struct *curr; // 正在运行的 task
+  struct task_struct *idle; // 本 hart 的 idle task
+  struct task_struct *prev; // 正在切换出去的 task，见 finish_task_switch
+  uint64_t id;              // hartid
+  bool resched;             // 返回用户态前需要重新调度，见 need_resched
+  uint64_t ipi_pending;     // 尚未处理的 IPI
+  struct task_struct *fp_owner; // 浮点寄存器中保存的是哪个 task 的状态，见 fpu.h
+};
+
+extern struct cpu cpus[NR_CPUS];
+
+/* 已经上线的 hart */
+extern uint64_t cpu_online_mask;
+
+static inline struct cpu *this_cpu(void) {
+  struct cpu *c;
+  asm volatile("mv %0, tp" : "=r"(c));
+  return c;
+}
+
+#define smp_processor_id() (this_cpu()->id)
+
+#define for_each_online_cpu(c) \
+  for (int c = 0; c < NR_CPUS; c++) if (cpu_online_mask & (1UL << (c)))
+
+/* 设置 tp 指向 hartid 对应的 struct cpu */
+void cpu_init(uint64_t hartid);
+
+/* hart 0 完成初始化后调用，放行其他 hart */
+void smp_boot_secondaries(void);
+
+/* 其他 hart 进入 S 模式后的 C 入口 */
+void secondary_start_kernel(uint64_t hartid);
+
+/* 向 mask 中的 hart 发送 IPI */
+void send_ipi(uint64_t mask, uint64_t ipi);
+
+/* 处理本 hart 上挂起的 IPI，在 S 模式软件中断或 idle 轮询时调用 */
+void handle_ipi(void);
+
+/* S 模式下中断是关闭的，忙等的地方用它检查并处理挂起的 IPI */
+static inline void ipi_poll(void) {
+  if (read_csr(sip) & SIP_SSIP) {
+    handle_ipi();
+  }
+}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+#include "defs.h"
+#include "smp.h"
+
+// S 模式下内核一直关着中断（sstatus.SIE = 0），所以加锁时不需要再关中断，
+// 只需要防止其他 hart 同时进入临界区。自旋时要处理发给自己的 IPI，
+// 否则持锁的 hart 若在等待本 hart 完成 TLB 刷新就会死锁
+
+struct spinlock {
+  volatile int locked;
+};
+
+#define SPINLOCK_INIT {0}
+
+static inline void spin_lock_init(struct spinlock *lock) {
+  lock->locked = 0;
+}
+
+static inline void spin_lock(struct spinlock *lock) {
+  while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+    while (lock->locked) {
+      ipi_poll();
+    }
+  }
+}
+
+/* 加锁成功返回 1，锁已被占用时立即返回 0 */
+static inline bool spin_trylock(struct spinlock *lock) {
+  return !__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void spin_unlock(struct spinlock *lock) {
+  __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
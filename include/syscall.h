@@ -1,16 +1,26 @@
 #pragma once
 
-#include "defs.h"
-
+#define SYS_DUP2 24
+#define SYS_FTRUNCATE 46
+#define SYS_PIPE 59
 #define SYS_EXIT 60
 #define SYS_READ 63
 #define SYS_WRITE 64
+#define SYS_VMSPLICE 75
+#define SYS_FUTEX 98
+#define SYS_NANOSLEEP 101
+#define SYS_SCHED_SETSCHEDULER 119
 #define SYS_GETPID 172
+#define SYS_GETTID 178
 #define SYS_EXEC 191
+#define SYS_BRK 214
 #define SYS_MUNMAP 215
 #define SYS_FORK 220
 #define SYS_MMAP 222
+#define SYS_MADVISE 233
 #define SYS_WAIT 247
+#define SYS_IO_URING_SETUP 425
+#define SYS_IO_URING_ENTER 426
 
 #define SFS_OPEN      1001
 #define SFS_CLOSE     1002
@@ -19,6 +29,15 @@
 #define SFS_WRITE     1005
 #define SFS_GET_FILES 1006
 
+#define SYS_SHM_OPEN   1007
+#define SYS_SHM_UNLINK 1008
+
+/* sys_call_table 的大小，系统调用号不小于它的走慢速路径 */
+#define NR_SYSCALLS (SYS_SHM_UNLINK + 1)
+
+#ifndef __ASSEMBLER__
+#include "defs.h"
+
 struct ret_info {
   uint64_t a0;
   uint64_t a1;
@@ -27,3 +46,14 @@ struct ret_info {
 struct ret_info syscall(uint64_t syscall_num, uint64_t arg0, uint64_t arg1,
                         uint64_t arg2, uint64_t arg3, uint64_t arg4,
                         uint64_t arg5, uint64_t sp);
+
+typedef long (*syscall_fn_t)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t,
+                             uint64_t);
+
+/* 快速路径的系统调用表，为 NULL 的项走 handler_s -> syscall()，见 entry.S */
+extern const syscall_fn_t sys_call_table[NR_SYSCALLS];
+
+/* 快速路径的系统调用返回用户态之前调用 */
+void syscall_exit(void);
+
+#endif
@@ -1,25 +1,53 @@
 #pragma once
 #include "defs.h"
+#include "fpu.h"
 #include "fs.h"
 #include "list.h"
+#include "rbtree.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "wait.h"
 
 #define TASK_SIZE (4096)
 #define THREAD_OFFSET (5 * 0x08)
 
 #ifndef __ASSEMBLER__
 
-/* task的最大数量 */
-#define NR_TASKS 64
-
-#define FIRST_TASK (task[0])
-#define LAST_TASK (task[NR_TASKS - 1])
-
 /* 定义task的状态，lab3中task只需要一种状态。*/
 #define TASK_RUNNING 0
-// #define TASK_INTERRUPTIBLE       1
+#define TASK_INTERRUPTIBLE 1 // 在等待队列上睡眠
 // #define TASK_UNINTERRUPTIBLE     2
-// #define TASK_ZOMBIE              3
+#define TASK_ZOMBIE 3 // 已退出，等待父进程 wait 取走退出码
 // #define TASK_STOPPED             4
+#define TASK_DEAD 5 // 已退出，task_struct 可被 fork 复用
+
+/* 优先级范围 [0, MAX_PRIO)，数值越小优先级越高 */
+#define MAX_PRIO 64
+#define DEFAULT_PRIO 32
+
+/* 调度类：按优先级轮转，或按 vruntime 公平调度；SCHED_PRIO 的进程总是先于 SCHED_FAIR 运行 */
+#define SCHED_PRIO 0
+#define SCHED_FAIR 1
+
+/* 新进程默认使用的调度类，可在编译时通过 -DSCHED_DEFAULT_POLICY=1 修改 */
+#ifndef SCHED_DEFAULT_POLICY
+#define SCHED_DEFAULT_POLICY SCHED_PRIO
+#endif
+
+/* nice 范围，nice 为 0 时权重为 NICE_0_LOAD */
+#define MIN_NICE (-20)
+#define MAX_NICE 19
+#define NICE_0_LOAD 1024
+
+/* SYS_FORK（即 clone）的标志，与 Linux 一致；标志为 0 时就是 fork */
+#define CLONE_VM 0x100    // 与当前进程共享地址空间，创建线程，arg1 为新线程的用户栈
+#define CLONE_FILES 0x400 // 与当前进程共享 fd 表
+
+/* task_struct.flags */
+#define PF_KTHREAD 0x1 // 内核线程：没有用户地址空间，只在 S 模式运行
+
+/* task_struct.comm 的长度（含结尾的 0） */
+#define TASK_COMM_LEN 16
 
 #define PREEMPT_ENABLE 0
 #define PREEMPT_DISABLE 1
@@ -28,11 +56,20 @@
 #define LAB_TEST_NUM 5
 #define LAB_TEST_COUNTER 5
 
-/* 当前进程 */
-extern struct task_struct *current;
+/* 本 hart 上的当前进程 */
+#define current (this_cpu()->curr)
 
-/* 进程指针数组 */
-extern struct task_struct *task[NR_TASKS];
+/* 当前进程的根页表（物理地址，内核可以直接访问），由 satp 的 PPN 得到 */
+#define current_pgtbl() ((uint64_t *)((current->satp & ((1ULL << 44) - 1)) << 12))
+
+/* 所有进程（不含 idle task）的链表，通过 task_struct.tasks 串起来 */
+extern struct list_head task_list;
+
+/* 保护 task_list、父子关系和 pid 分配 */
+extern struct spinlock tasklist_lock;
+
+/* 内核栈顶保存着 task 所在 hart 的 struct cpu 指针，trap_s 据此恢复 tp */
+#define TASK_STACK_TOP(p) ((p)->stack + PAGE_SIZE - 16)
 
 /* 进程状态段数据结构 */
 struct thread_struct {
@@ -64,6 +101,8 @@ struct vm_area_struct {
   unsigned long vm_end;
   /* linked list of VM areas per task, sorted by address. */
   struct list_head vm_list;
+  /* node in mm->mm_rb, keyed by vm_start. */
+  struct rb_node vm_rb;
   // vm_page_prot和vm_flags的具体含义本实验不做要求，可以直接把vm_flags用于保存page_table的权限位。
   /* Access permissions of this VMA. */
   pgprot_t vm_page_prot;
@@ -71,13 +110,34 @@ struct vm_area_struct {
   unsigned long vm_flags;
   /* mapped */
   bool mapped;
+  /* mmap flags (MAP_SHARED / MAP_PRIVATE ...) */
+  unsigned long vm_mmap_flags;
+  /* file-backed mapping: inode block number and page offset in the file */
+  uint32_t vm_ino;
+  uint64_t vm_pgoff;
+  /* cached SFS block mapped at each page, NULL for anonymous memory */
+  struct sfs_memory_block **vm_pages;
+  /* shared memory object mapped by MAP_SHARED anonymous / shm mappings, see shm.h */
+  struct shm_object *vm_shm;
 };
 
+struct io_ring_ctx;
+struct vvar_data;
+
 /* 内存管理 */
 struct mm_struct {
   struct vm_area_struct *vm;   // 虚拟内存区域描述符
-  uint64_t user_program_start; // 进程起始地址（物理）
+  struct rb_root mm_rb;        // 按地址排序的 VMA 红黑树
+  struct vm_area_struct *mmap_cache; // 上一次 find_vma 命中的 VMA
   uint64_t user_stack;         // 用户栈地址(物理)
+  uint64_t context_id;         // ASID 及其分配时的 generation，见 tlb.c
+  uint64_t cpu_mask;           // 运行过该地址空间的 hart
+  uint64_t tlb_stale_mask;     // TLB 中可能残留过期项、下次切换时需要刷新的 hart
+  uint64_t start_brk;          // 堆的起始地址
+  uint64_t brk;                // 当前 program break
+  struct io_ring_ctx *uring;   // io_uring 共享环，见 io_uring.h
+  int users;                   // 共享这个地址空间的线程数，见 clone_thread
+  struct spinlock lock;        // 保护 VMA 和用户页表：同一地址空间的线程可能同时在多个 hart 上缺页
 };
 
 struct file {
@@ -88,17 +148,23 @@ struct file {
   // 可以增加额外数据来辅助你的缓存管理
   uint32_t inode_no;
   uint32_t path_no;
+  int type;            // FILE_SFS、FILE_PIPE 或 FILE_SHM，见 pipe.h
+  struct pipe *pipe;   // type 为 FILE_PIPE 时指向管道，flags 表示是读端还是写端
+  struct shm_object *shm; // type 为 FILE_SHM 时指向共享内存对象
+  int refs;            // 管道和共享内存：fd 表持有一个，正在使用它的系统调用各持有一个，见 fget
 };
 
 struct files_struct {
   struct file * fds[16];  // 一个进程最多可以同时打开 16 个文件
+  int count;              // 共享这张 fd 表的线程数
+  struct spinlock lock;   // 保护 fds[] 中 fd 的分配、装入和移除，共享这张表的线程可能同时打开、关闭文件
 };
 
 /* 进程数据结构 */
 struct task_struct {
   long state;    // 进程状态 Lab3中进程初始化时置为TASK_RUNNING
-  long counter;  // 运行剩余时间
-  long priority; // 运行优先级 1最高 5最低
+  long counter;  // 剩余时间片（tick 数）
+  long priority; // 运行优先级 [0, MAX_PRIO)，0最高
   long blocked;
   long pid; // 进程标识符
             // Above Size Cost: 40 bytes
@@ -108,12 +174,99 @@ struct task_struct {
   uint64_t sscratch; // 保存 sscratch
   uint64_t satp;     // 保存 satp
 
-  struct mm_struct mm;
-  struct files_struct fs;
+  struct mm_struct *mm;    // 用户地址空间，CLONE_VM 创建的线程共享同一个，内核线程为 NULL
+  struct files_struct *fs; // fd 表，CLONE_FILES 创建的线程共享同一个
+  long tgid;               // 所属进程（线程组）的 pid，即创建它的进程的 tgid
+
+  struct list_head run_list; // 在 runqueue 中所在优先级队列的链表节点
+  bool on_rq;                // 是否在 runqueue 中
+  int cpu;                   // 所在 runqueue 的 hart
+  volatile bool on_cpu;      // 正在某个 hart 上运行（包括正在切换出去）
+
+  int policy;                // 调度类，SCHED_PRIO 或 SCHED_FAIR
+  long nice;                 // SCHED_FAIR 的 nice 值 [MIN_NICE, MAX_NICE]
+  struct rb_node run_node;   // 在公平调度红黑树中的节点
+  uint64_t vruntime;         // 按 nice 加权的虚拟运行时间
+  uint64_t exec_start;       // 本次开始计时的 mtime
+  uint64_t sum_exec_runtime; // 累计运行时间
+  uint64_t prev_sum_exec_runtime; // 被选中运行时的 sum_exec_runtime
+
+  struct task_struct *parent;  // 父进程，父进程先退出时为 NULL
+  struct list_head children;   // 子进程链表
+  struct list_head sibling;    // 在父进程 children 链表中的节点
+  struct wait_queue_head wait_chldexit; // 在 wait 中等待子进程退出
+  int exit_code;               // 退出码，TASK_ZOMBIE 时有效
+
+  unsigned long flags;         // PF_* 标志
+  char comm[TASK_COMM_LEN];    // 名字，目前只有内核线程会设置
+
+  struct fp_state fp;          // 换出时保存的浮点寄存器，见 fpu.h
+  int fp_cpu;                  // 上一次在哪个 hart 上恢复了浮点状态，-1 表示没有
+  struct vvar_data *vvar;      // 映射到用户空间的 vvar 页（物理地址），见 vdso.h
+
+  uint64_t stack;              // 内核栈所在页（虚拟地址）
+  struct list_head tasks;      // 在 task_list 中的节点
+  struct list_head pid_chain;  // 在 pid 哈希表中的节点
 };
 
+/* 返回所属进程的 pid，线程返回的是创建它的进程的 pid（tgid） */
 int getpid();
 
+/* 分配 task_struct、内核栈和 pid，并加入 task_list 和 pid 哈希表，失败返回 NULL */
+struct task_struct *alloc_task(void);
+
+/* 释放 alloc_task 分配、还没有运行过也没有挂到父进程上的进程（fork 失败时） */
+void free_new_task(struct task_struct *p);
+
+/* 释放已经退出且不会再运行的 task */
+void free_dead_tasks(void);
+
+/* 自行退出的 task 切换出去之后调用，把回收交给 kworker */
+void schedule_reap(void);
+
+/* 建立 p 与父进程 parent 的父子关系 */
+void link_child(struct task_struct *p, struct task_struct *parent);
+
+/* 进程退出时调用：托管子进程，变为僵尸进程并唤醒在 wait 的父进程 */
+void exit_notify(int code);
+
+/* 分配一个空的用户地址空间（只初始化 VMA 链表），users 为 1，失败返回 NULL */
+struct mm_struct *mm_alloc(void);
+
+/* 进程退出时调用：切换到内核页表并释放 current 对 mm 的引用，
+ * 最后一个线程退出时释放所有 VMA、用户栈、vvar 页和页表 */
+void exit_mm(void);
+
+/* 释放没有线程在使用的 mm：所有 VMA、用户栈、p 的 vvar 页、根页表和 mm 本身 */
+void mm_destroy(struct mm_struct *mm, uint64_t *root_page_table, struct task_struct *p);
+
+/* 分配一张空的 fd 表，count 为 1，失败返回 NULL */
+struct files_struct *files_alloc(void);
+
+/* 释放对 fd 表的一个引用，最后一个引用关闭其中的管道和共享内存 fd 并释放 fd 表 */
+void put_files(struct files_struct *fs);
+
+/* 在 files 中找一个不小于 from 的空闲 fd 装入 f，返回 fd，没有空闲 fd 返回 -1 */
+int fd_install(struct files_struct *files, int from, struct file *f);
+
+/* fd 是 type 类型的文件时把它从 files 中移除并返回，否则返回 NULL，
+ * 两个线程同时关闭同一个 fd 时只有一个能拿到它 */
+struct file *fd_remove(struct files_struct *files, int fd, int type);
+
+/* fd 是 type（FILE_PIPE 或 FILE_SHM）类型的文件时取得它的一个引用并返回，否则返回 NULL。
+ * 同一张 fd 表的其他线程可能同时关闭这个 fd，用完后必须 fput */
+struct file *fget(struct files_struct *files, int fd, int type);
+
+/* 释放 fget 或 fd 表持有的引用，最后一个引用关闭管道的一端或共享内存 fd */
+void fput(struct file *f);
+
+/* 返回 fd 对应文件的 type，fd 没有打开时返回 -1 */
+int fd_type(struct files_struct *files, int fd);
+
+/* 等待 pid 对应的子进程退出（pid 为 -1 时等待任意子进程），返回其 pid，没有这样的子进程返回 -1；
+ * status 不为 NULL 时写入退出码，写不进去时返回 -1，子进程不被回收 */
+long do_wait(long pid, int *status);
+
 /* 进程初始化 创建四个dead_loop进程 */
 void task_init(void);
 
@@ -0,0 +1,74 @@
+#pragma once
+#include "defs.h"
+#include "list.h"
+
+/* 时钟中断频率，可在编译时通过 -DHZ=... 修改 */
+#ifndef HZ
+#define HZ 100
+#endif
+
+/* QEMU virt 机器上 mtime 的频率为 10MHz */
+#define TIMEBASE_FREQ 10000000UL
+
+/* 两次时钟中断之间的 mtime 增量 */
+#define TICK_INTERVAL (TIMEBASE_FREQ / HZ)
+
+/* 纳秒换算为 mtime 计数，向上取整，保证不会提前到期 */
+#define NSEC_PER_SEC 1000000000UL
+#define NS_TO_CYCLES(ns) (((ns) * (TIMEBASE_FREQ / 1000000) + 999) / 1000)
+
+/* 毫秒换算为 tick 数，至少为 1 */
+#define MS_TO_TICKS(ms) (((ms) * HZ + 999) / 1000)
+
+/* 启动以来的 tick 数，由 hart 0 维护 */
+extern uint64_t jiffies;
+
+/* 设置本 hart 的第一次时钟中断 */
+void timer_init(void);
+
+/* S 模式时钟中断处理：重新设置 mtimecmp 并调用 do_timer */
+void timer_interrupt(void);
+
+/* idle 时停掉周期 tick，只在下一个真正的定时事件到来时产生时钟中断 */
+void tick_nohz_idle_enter(void);
+
+/* 退出 idle：按睡眠时长补上 jiffies，并恢复周期 tick */
+void tick_nohz_idle_exit(void);
+
+/*
+ * 软件定时器：每个 hart 一个分层时间轮（见 timer.c），定时器挂在调用 add_timer
+ * 的 hart 上，到期后在该 hart 的时钟中断中调用 function。mtimecmp 总是设置为
+ * 下一个 tick 与最早的定时器中较早的那个，所以定时器不需要等到 tick 才被处理。
+ */
+struct timer_list {
+  struct list_head entry;   // 在时间轮槽中的节点，未挂入时为空链表
+  uint64_t expires;         // 到期时间（mtime 值）
+  void (*function)(struct timer_list *);
+  uint64_t cpu;             // 挂在哪个 hart 的时间轮上
+  uint64_t slot;            // 所在的槽：level * WHEEL_SIZE + idx
+};
+
+struct timespec {
+  long tv_sec;
+  long tv_nsec;
+};
+
+static inline void timer_setup(struct timer_list *timer,
+                               void (*function)(struct timer_list *)) {
+  INIT_LIST_HEAD(&timer->entry);
+  timer->function = function;
+}
+
+static inline bool timer_pending(struct timer_list *timer) {
+  return !list_empty(&timer->entry);
+}
+
+/* 把定时器挂到本 hart 的时间轮上，timer 不能已经在时间轮中 */
+void add_timer(struct timer_list *timer);
+
+/* 取消定时器，返回它是否还未到期。回调在调用前已摘下定时器，且调用后不再访问它，
+ * 所以返回 0 之后 timer 所在的内存即可释放 */
+int del_timer(struct timer_list *timer);
+
+/* current 睡眠到 mtime 达到 deadline */
+void schedule_timeout(uint64_t deadline);
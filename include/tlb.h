@@ -0,0 +1,64 @@
+#pragma once
+
+#include "defs.h"
+
+#ifndef __ASSEMBLER__
+
+struct mm_struct;
+struct task_struct;
+
+/* satp 寄存器各字段 (Sv39) */
+#define SATP_MODE_SV39 0x8000000000000000
+#define SATP_ASID_SHIFT 44
+#define SATP_ASID_MASK 0xffffUL
+#define SATP_PPN_MASK ((1ULL << SATP_ASID_SHIFT) - 1)
+
+/* mm->context_id 的低 ASID_MAX_BITS 位为 ASID，其余高位为分配时的 generation */
+#define ASID_MAX_BITS 16
+#define ASID_FIRST_VERSION (1UL << ASID_MAX_BITS)
+
+/* 超过该页数的范围刷新直接按 ASID 整体刷新 */
+#define TLB_FLUSH_PAGE_LIMIT 64
+
+/* 刷新本 hart 上所有地址空间的全部 TLB 项 */
+static inline void local_flush_tlb_all(void) {
+  asm volatile("sfence.vma" ::: "memory");
+}
+
+/* 只刷新某个 ASID 的全部 TLB 项 */
+static inline void local_flush_tlb_asid(uint64_t asid) {
+  asm volatile("sfence.vma zero, %0" ::"r"(asid) : "memory");
+}
+
+/* 只刷新某个 ASID 下某一页的 TLB 项 */
+static inline void local_flush_tlb_page(uint64_t asid, uint64_t va) {
+  asm volatile("sfence.vma %0, %1" ::"r"(va), "r"(asid) : "memory");
+}
+
+/* 探测硬件实际支持的 ASID 位数，初始化 ASID 分配器 */
+void asid_init(void);
+
+/* 切换到 next 之前调用：保证 next 的 ASID 属于当前 generation，并据此更新 next->satp */
+void check_and_switch_context(struct task_struct *next);
+
+/* 切换到 idle task 或内核线程（内核启动页表）时调用，本 hart 不再运行任何用户地址空间 */
+void switch_to_idle_mm(void);
+
+/* 收到 IPI_TLB_FLUSH 时调用，刷新本 hart 的全部 TLB */
+void tlb_flush_ipi(void);
+
+/* 返回 mm 当前使用的 ASID */
+uint64_t mm_asid(struct mm_struct *mm);
+
+/* 以下刷新函数同时处理其他 hart：正在运行 mm 的 hart 通过 IPI 同步刷新 */
+
+/* 刷新 mm 在 [start, end) 范围内的 TLB 项 */
+void flush_tlb_range(struct mm_struct *mm, uint64_t start, uint64_t end);
+
+/* 刷新 mm 在 va 所在页的 TLB 项 */
+void flush_tlb_page(struct mm_struct *mm, uint64_t va);
+
+/* 刷新 mm 的全部 TLB 项 */
+void flush_tlb_mm(struct mm_struct *mm);
+
+#endif
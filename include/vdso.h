@@ -0,0 +1,37 @@
+#pragma once
+#include "defs.h"
+
+// vvar 页：每个进程一页，只读映射在用户地址空间的 VVAR_ADDR 处，
+// 内核直接修改其中的数据，用户库读取它就能得到 pid、单调时钟和进程计数器，不需要陷入内核。
+// 单调时钟 = (time CSR - clock_base) / timebase_freq，用户态读取 time CSR 由 scounteren.TM 允许。
+// 布局与用户库 vdso.h 中的定义一致。
+
+#define VVAR_ADDR 0x1004000
+
+struct vvar_data {
+  uint64_t timebase_freq;  // time CSR 的频率
+  uint64_t clock_base;     // 单调时钟零点对应的 time 值
+  int64_t pid;
+  uint64_t nr_syscalls;    // 系统调用次数
+  uint64_t nr_page_faults; // 缺页次数
+  uint64_t nr_switches;    // 被切换出 CPU 的次数
+};
+
+struct task_struct;
+
+/* 计数器加一，内核线程和 idle 没有 vvar 页。
+ * 同一进程的线程共享 vvar 页，可能同时在不同的 hart 上计数，所以用原子加 */
+#define vvar_inc(p, field)                                              \
+  do {                                                                  \
+    if ((p)->vvar)                                                      \
+      __atomic_add_fetch(&(p)->vvar->field, 1, __ATOMIC_RELAXED);       \
+  } while (0)
+
+/* 记录单调时钟的零点，启动时调用一次 */
+void vdso_init(void);
+
+/* 为用户进程 p 分配 vvar 页并映射到 pgtbl 的 VVAR_ADDR，失败返回 -1 */
+int vvar_setup(struct task_struct *p, uint64_t *pgtbl);
+
+/* 进程退出时释放 vvar 页 */
+void vvar_release(struct task_struct *p);
@@ -104,4 +104,5 @@ void plic_init(void);
 void virtio_disk_init(void);
 void virtio_disk_rw(struct buf *b, int write);
 void virtio_disk_intr();
-int plic_claim(void);
\ No newline at end of file
+int plic_claim(void);
+void plic_complete(int irq);
\ No newline at end of file
@@ -8,6 +8,28 @@
 #define PTE_X 0x008 // Execute
 #define PTE_U 0x010 // User
 
+/* mmap flags */
+#define MAP_SHARED 0x01
+#define MAP_PRIVATE 0x02
+#define MAP_ANONYMOUS 0x20
+#define MAP_POPULATE 0x8000 // 在 mmap 时立即分配物理页并建立映射
+
+/* 内核内部使用的 vm_mmap_flags：匿名区域逐页分配（用于可伸缩的堆） */
+#define VM_PAGED 0x80000000
+/* 内核内部使用的 vm_mmap_flags：io_uring 的共享环，见 io_uring.h */
+#define VM_URING 0x40000000
+
+/* 用户堆的起始虚拟地址 */
+#define USER_HEAP_START 0x4000000
+/* 用户自己指定地址的映射只能放在 [USER_HEAP_START, USER_MMAP_END)：
+ * 再往上是 PLIC、UART 和内核的等值映射，下面是程序段、用户栈和 vvar 页 */
+#define USER_MMAP_END 0x0c000000
+
+/* madvise advice，只支持 MADV_WILLNEED 和 MADV_DONTNEED，其他的返回 -1 */
+#define MADV_NORMAL 0
+#define MADV_WILLNEED 3 // 立即分配物理页并建立映射
+#define MADV_DONTNEED 4 // 释放物理页，但保留 VMA，再次访问时重新缺页
+
 #define PHYSICAL_ADDR(x) (((uint64_t)(x)) & 0xffffffff | 0x80000000)
 #define VIRTUAL_ADDR(x) (((uint64_t)(x)) & 0xfffffff | 0xffffffc000000000)
 
@@ -17,3 +39,53 @@ void create_mapping(uint64_t *pgtbl, uint64_t va, uint64_t pa, uint64_t sz,
 uint64_t get_pte(uint64_t *pgtbl, uint64_t va);
 
 void paging_init();
+
+struct mm_struct;
+struct vm_area_struct;
+
+// 以下查找、修改 VMA 或用户页表的函数由调用者持有 mm->lock：
+// 同一地址空间的线程可能同时在多个 hart 上缺页、mmap 或 munmap
+
+/* 初始化 mm 的 VMA 链表和红黑树 */
+void vma_init(struct mm_struct *mm);
+
+/* 返回包含 addr 的 VMA，没有则返回 NULL */
+struct vm_area_struct *find_vma(struct mm_struct *mm, uint64_t addr);
+
+/* 将 vma 按地址插入 mm 的红黑树和 vm_list */
+void insert_vma(struct mm_struct *mm, struct vm_area_struct *vma);
+
+/* 将 vma 从 mm 中摘除（不释放 vma 本身） */
+void remove_vma(struct mm_struct *mm, struct vm_area_struct *vma);
+
+/* 返回第一个 vm_end > addr 的 VMA，没有则返回 NULL */
+struct vm_area_struct *find_vma_next(struct mm_struct *mm, uint64_t addr);
+
+/* 处理 vma 中 addr 处的缺页，write 表示是否为写访问，失败返回 -1 */
+int handle_vma_fault(struct mm_struct *mm, uint64_t *pgtbl,
+                     struct vm_area_struct *vma, uint64_t addr, bool write);
+
+/* fork 时把 src 的映射内容复制到子进程页表中的 dst，失败返回 -1，
+ * 此时 dst 中已复制的部分仍可以用 destroy_vma 释放 */
+int copy_vma(uint64_t *dst_pgtbl, uint64_t *src_pgtbl,
+             struct vm_area_struct *dst, struct vm_area_struct *src);
+
+/* 将 mm 的 program break 调整到 addr（不超过 USER_MMAP_END），返回调整后的 break（失败时为原值） */
+uint64_t do_brk(struct mm_struct *mm, uint64_t *pgtbl, uint64_t addr);
+
+/* 为 vma 分配物理页并在 pgtbl 中建立映射，已映射时直接返回 0，失败返回 -1 */
+int populate_vma(uint64_t *pgtbl, struct vm_area_struct *vma);
+
+/* 释放 vma 的物理页、清除映射并刷新 TLB，VMA 本身保留 */
+void zap_vma(struct mm_struct *mm, uint64_t *pgtbl, struct vm_area_struct *vma);
+
+/* 内核直接读写 current 的用户内存 [addr, addr + len) 之前调用：S 模式下的访问不能缺页，
+ * 先为尚未映射的页（或写访问时的只读页）处理缺页，地址非法时返回 -1。自己持有 mm->lock */
+int fault_in_user(uint64_t addr, uint64_t len, bool write);
+
+/* 把用户地址 src 处以 '\0' 结尾的字符串拷贝到 dst（最多 size 字节，含 '\0'），
+ * 地址非法或超长时返回 -1 */
+int copy_str_from_user(char *dst, const char *src, uint64_t size);
+
+/* 释放 vma 的全部资源并从 mm 中摘除 */
+void destroy_vma(struct mm_struct *mm, uint64_t *pgtbl, struct vm_area_struct *vma);
@@ -0,0 +1,41 @@
+#pragma once
+#include "defs.h"
+#include "list.h"
+#include "spinlock.h"
+
+struct task_struct;
+
+/* 等待队列：在某个条件上睡眠的进程挂在 head 上，条件满足时由 wake_up 唤醒 */
+struct wait_queue_head {
+  struct spinlock lock;
+  struct list_head head;
+};
+
+struct wait_queue_entry {
+  struct task_struct *task;
+  struct list_head entry;
+};
+
+#define init_waitqueue_head(wq)   \
+  do {                            \
+    spin_lock_init(&(wq)->lock);  \
+    INIT_LIST_HEAD(&(wq)->head);  \
+  } while (0)
+
+/* 当前进程在 wq 上睡眠，直到被 wake_up 唤醒 */
+void sleep_on(struct wait_queue_head *wq);
+
+/* 同 sleep_on，但调用时持有保护睡眠条件的 lock：挂到 wq 上之后才释放 lock，
+ * 唤醒后重新加锁，这样检查条件与睡眠之间的唤醒不会丢失 */
+void sleep_on_locked(struct wait_queue_head *wq, struct spinlock *lock);
+
+/* 唤醒 wq 上的所有进程 */
+void wake_up(struct wait_queue_head *wq);
+
+/* 睡眠直到 condition 成立，唤醒后会重新检查 condition */
+#define wait_event(wq, condition) \
+  do {                            \
+    while (!(condition)) {        \
+      sleep_on(wq);               \
+    }                             \
+  } while (0)
@@ -0,0 +1,51 @@
+#pragma once
+#include "defs.h"
+#include "list.h"
+#include "spinlock.h"
+#include "wait.h"
+
+// 工作队列：把不必在调用者路径上完成的工作（回收、写回等）挂到队列上，
+// 由队列自己的内核线程（worker）依次执行
+
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct work_struct {
+  struct list_head entry; // 在 worklist 中的节点
+  work_func_t func;
+  bool pending;           // 已在队列中，尚未开始执行
+};
+
+#define INIT_WORK(work, fn)            \
+  do {                                 \
+    INIT_LIST_HEAD(&(work)->entry);    \
+    (work)->func = (fn);               \
+    (work)->pending = 0;               \
+  } while (0)
+
+struct workqueue_struct {
+  const char *name;
+  struct spinlock lock;
+  struct list_head worklist;          // 等待执行的 work
+  unsigned long nr_active;            // 已入队但还没执行完的 work 数
+  struct wait_queue_head more_work;   // worker 在这里等待新的 work
+  struct wait_queue_head flush_wait;  // flush_workqueue 在这里等待 nr_active 归零
+};
+
+/* 默认的工作队列 */
+extern struct workqueue_struct *system_wq;
+
+/* 创建有 nr_workers 个 worker 线程的工作队列，失败返回 NULL */
+struct workqueue_struct *create_workqueue(const char *name, int nr_workers);
+
+/* 把 work 加入队列，work 已在队列中时什么都不做并返回 0 */
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work);
+
+/* 等待队列中已有的 work 全部执行完 */
+void flush_workqueue(struct workqueue_struct *wq);
+
+/* 加入默认工作队列 */
+#define schedule_work(work) queue_work(system_wq, (work))
+
+/* 创建 system_wq，需要在 task_init 之后调用 */
+void workqueue_init(void);
@@ -31,13 +31,85 @@ struct sfs_entry {
     char filename[SFS_MAX_FILENAME_LEN + 1]; // 文件名
 };
 
+static struct sfs_super super_block;
+static char freemap[4096];
+
+// 0 超级块，1 根目录 inode，2 freemap，3 根目录的 "." 项，之后的块按顺序分配
+static uint32_t next_block = 4;
+
+static uint32_t alloc_block(void) {
+    uint32_t no = next_block++;
+    freemap[no / 8] |= 1 << (no % 8);
+    super_block.unused_blocks--;
+    return no;
+}
+
+static void write_block(FILE *fp, uint32_t no, const void *data, size_t len) {
+    fseek(fp, 4096L * no, SEEK_SET);
+    fwrite(data, sizeof(char), len, fp);
+}
+
+// 把主机上的文件 path 以 name 为名放进根目录，布局与 fs.c 中 sfs_write 写出的文件相同：
+// 每个目录项、inode 各占一块，inode 的直接索引用完后由 indirect 接下一个 inode
+static int add_file(FILE *img, struct sfs_inode *root, const char *name, const char *path) {
+    if (strlen(name) > SFS_MAX_FILENAME_LEN || root->blocks == SFS_NDIRECT) {
+        printf("Cannot add %s\n", name);
+        return -1;
+    }
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        printf("%s not found!\n", path);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if ((size + 4095) / 4096 * 2 + 2 > super_block.blocks - next_block) {
+        printf("%s is too large!\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    struct sfs_entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.ino = alloc_block();
+    strcpy(entry.filename, name);
+    uint32_t entry_no = alloc_block();
+    write_block(img, entry_no, &entry, sizeof(entry));
+    root->direct[root->blocks++] = entry_no;
+
+    struct sfs_inode inode;
+    memset(&inode, 0, sizeof(inode));
+    inode.size  = size;
+    inode.links = 1;
+    uint32_t inode_no = entry.ino;
+
+    char data[4096];
+    size_t n;
+    while ((n = fread(data, sizeof(char), sizeof(data), fp)) > 0) {
+        if (inode.blocks == SFS_NDIRECT) {
+            inode.indirect = alloc_block();
+            write_block(img, inode_no, &inode, sizeof(inode));
+            inode_no = inode.indirect;
+            memset(&inode, 0, sizeof(inode));
+            inode.links = 1;
+        }
+        memset(data + n, 0, sizeof(data) - n);
+        uint32_t no = alloc_block();
+        write_block(img, no, data, sizeof(data));
+        inode.direct[inode.blocks++] = no;
+    }
+    write_block(img, inode_no, &inode, sizeof(inode));
+    fclose(fp);
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printf("Usage: mksfs sfs.img\n");
+    if (argc < 2) {
+        printf("Usage: mksfs sfs.img [name=file ...]\n");
         return -1;
     }
     
-    struct sfs_super super_block;
     super_block.magic         = SFS_MAGIC;
     super_block.blocks        = 4096;
     super_block.unused_blocks = 4096 - 4;
@@ -51,7 +123,6 @@ int main(int argc, char *argv[]) {
     root_inode.direct[0] = 3;
     root_inode.indirect  = 0;
 
-    char freemap[4096];
     memset(freemap, 0, sizeof(freemap));
     freemap[0] = 0b00001111;
     
@@ -65,6 +136,23 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
+    // 其余参数是要放进根目录的文件：name=file
+    for (int i = 2; i < argc; i++) {
+        char name[SFS_MAX_FILENAME_LEN + 2];
+        char *sep = strchr(argv[i], '=');
+        if (sep == NULL || sep == argv[i] || sep - argv[i] > SFS_MAX_FILENAME_LEN) {
+            printf("Invalid argument %s\n", argv[i]);
+            fclose(fp);
+            return -1;
+        }
+        memcpy(name, argv[i], sep - argv[i]);
+        name[sep - argv[i]] = '\0';
+        if (add_file(fp, &root_inode, name, sep + 1)) {
+            fclose(fp);
+            return -1;
+        }
+    }
+
     fseek(fp, 0, SEEK_SET);
     fwrite((char *)&super_block, sizeof(char), sizeof(super_block), fp);
 